@@ -7,6 +7,8 @@
 
 #include <atomic>
 #include <deque>
+#include <iterator>
+#include <memory_resource>
 #include <mutex>
 
 namespace tp {
@@ -14,8 +16,10 @@ namespace tp {
     template <typename T>
     class BlockingQueue {
     public:
-        using size_type = typename std::deque<T>::size_type;
+        using size_type = typename std::pmr::deque<T>::size_type;
         BlockingQueue() = default;
+        // 队列的内存块从 mr 分配，mr 必须线程安全
+        explicit BlockingQueue(std::pmr::memory_resource* mr) : data_(mr) {}
         BlockingQueue(const BlockingQueue&) = delete;
         BlockingQueue(BlockingQueue&&) = default;
         BlockingQueue& operator=(const BlockingQueue&) = delete;
@@ -61,6 +65,19 @@ namespace tp {
             data_.emplace_front(std::move(v));
         }
 
+        // 整批移动到队尾/队首，只加一次锁，批内顺序保持不变
+        template <typename It>
+        void push_back_bulk(It first, It last) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            data_.insert(data_.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+        }
+
+        template <typename It>
+        void push_front_bulk(It first, It last) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            data_.insert(data_.begin(), std::make_move_iterator(first), std::make_move_iterator(last));
+        }
+
         bool try_pop(T& v) {
             std::lock_guard<std::mutex> lock(mtx_);
             if(!data_.empty()) {
@@ -71,6 +88,20 @@ namespace tp {
             return false;
         }
 
+        // 取出第一个满足 pred 的元素，需要遍历队列，只用于少见的路径
+        template <typename Pred>
+        bool try_pop_if(T& v, Pred pred) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for(auto it = data_.begin(); it != data_.end(); ++it) {
+                if(pred(*it)) {
+                    v = std::move(*it);
+                    data_.erase(it);
+                    return true;
+                }
+            }
+            return false;
+        }
+
         size_type size() const {
             std::lock_guard<std::mutex> lock(mtx_);
             return data_.size();
@@ -78,7 +109,7 @@ namespace tp {
 
     private:
         mutable std::mutex mtx_;
-        std::deque<T> data_;
+        std::pmr::deque<T> data_;
     };
 
 }
@@ -0,0 +1,116 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Metrics.h"
+
+namespace tp {
+
+    // 任务在开始执行之前被取消时，它的 future 以这个异常结束
+    class task_cancelled : public std::runtime_error {
+    public:
+        task_cancelled() : std::runtime_error("workspace: task was cancelled before it started") {}
+    };
+
+    namespace detail {
+        // 句柄、stop_token 和排队中的任务共享的状态
+        struct cancel_state {
+            enum : int { pending, running, cancelled };
+            std::atomic<int> status{pending};
+            std::atomic<bool> stop{false};
+
+            // 任务出队后调用：pending → running；已被取消则返回 false，任务直接丢弃
+            bool begin() noexcept {
+                int expected = pending;
+                if(status.compare_exchange_strong(expected, running, std::memory_order_acq_rel))
+                    return true;
+                if(auto* m = current_metrics)
+                    m->tasks_cancelled.add();
+                return false;
+            }
+        };
+    }
+
+    // 执行中的任务用它轮询是否已被请求停止；默认构造的 token 永远不会被请求停止
+    class stop_token {
+        std::shared_ptr<const detail::cancel_state> st_;
+    public:
+        stop_token() noexcept = default;
+        explicit stop_token(std::shared_ptr<const detail::cancel_state> st) noexcept : st_(std::move(st)) {}
+
+        [[nodiscard]] bool stop_requested() const noexcept {
+            return st_ && st_->stop.load(std::memory_order_acquire);
+        }
+        [[nodiscard]] bool stop_possible() const noexcept {
+            return static_cast<bool>(st_);
+        }
+    };
+
+    // submit_cancellable / async_cancellable 返回的取消句柄，可以复制，任务结束后仍然有效
+    class cancel_handle {
+        std::shared_ptr<detail::cancel_state> st_;
+    public:
+        cancel_handle() noexcept = default;
+        explicit cancel_handle(std::shared_ptr<detail::cancel_state> st) noexcept : st_(std::move(st)) {}
+
+        // 请求停止。尚未开始的任务不会执行：不扫描队列，出队时才丢弃，future 以 task_cancelled 结束；
+        // 已经开始的任务照常完成，可以通过 stop_token 得知。返回 true 表示任务不会执行
+        bool cancel() noexcept {
+            if(!st_)
+                return false;
+            st_->stop.store(true, std::memory_order_release);
+            int expected = detail::cancel_state::pending;
+            return st_->status.compare_exchange_strong(expected, detail::cancel_state::cancelled, std::memory_order_acq_rel);
+        }
+
+        // 任务因取消而不会执行
+        [[nodiscard]] bool cancelled() const noexcept {
+            return st_ && st_->status.load(std::memory_order_acquire) == detail::cancel_state::cancelled;
+        }
+        [[nodiscard]] bool stop_requested() const noexcept {
+            return st_ && st_->stop.load(std::memory_order_acquire);
+        }
+        [[nodiscard]] stop_token token() const noexcept {
+            return stop_token(st_);
+        }
+    };
+
+    // 可取消提交的返回值，可以用结构化绑定拆开：auto [fut, handle] = br.submit_cancellable(fn);
+    template <typename Future>
+    struct cancellable {
+        Future result;
+        cancel_handle handle;
+    };
+
+    namespace detail {
+        // 任务可以是 fn() 或 fn(stop_token)，后者在执行中途轮询取消
+        template <typename F>
+        decltype(auto) invoke_with_token(F& fn, const std::shared_ptr<cancel_state>& st) {
+            if constexpr (std::is_invocable_v<F&, stop_token>)
+                return fn(stop_token(st));
+            else
+                return fn();
+        }
+
+        template <typename F, typename = void>
+        struct token_result { using type = std::invoke_result_t<F&>; };
+        template <typename F>
+        struct token_result<F, std::enable_if_t<std::is_invocable_v<F&, stop_token>>> {
+            using type = std::invoke_result_t<F&, stop_token>;
+        };
+        template <typename F>
+        using token_result_t = typename token_result<std::decay_t<F>>::type;
+    }
+
+}
+
+#endif //CANCELLATION_H
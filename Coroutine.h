@@ -0,0 +1,238 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+// 协程支持是可选的：只有以 C++20 编译并包含本头文件时才启用，核心部分仍然是 C++17
+#if !defined(__cpp_impl_coroutine) || __cplusplus < 202002L
+#error "Coroutine.h requires C++20 coroutines (e.g. -std=c++20)"
+#endif
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "WorkBranch.h"
+
+namespace tp {
+
+    template <typename T = void>
+    class task;
+
+    namespace detail {
+        struct task_promise_base {
+            std::coroutine_handle<> continuation_ = std::noop_coroutine();
+            std::exception_ptr error_;
+
+            // 结束时直接切换到等待者（对称转移），不占用额外的栈，也不阻塞线程
+            struct final_awaiter {
+                [[nodiscard]] bool await_ready() const noexcept { return false; }
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                    return h.promise().continuation_;
+                }
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }  // 惰性启动，被 co_await 时才运行
+            final_awaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() noexcept { error_ = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct task_promise : task_promise_base {
+            std::optional<T> value_;
+
+            task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U&& v) { value_.emplace(std::forward<U>(v)); }
+
+            T result() {
+                if(error_)
+                    std::rethrow_exception(error_);
+                return std::move(*value_);
+            }
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base {
+            task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {}
+
+            void result() const {
+                if(error_)
+                    std::rethrow_exception(error_);
+            }
+        };
+    }
+
+    // 惰性协程任务：co_await 时才开始执行，完成后恢复等待它的协程
+    // 需要切换到线程池时 co_await branch.schedule()
+    template <typename T>
+    class [[nodiscard]] task {
+        static_assert(!std::is_reference_v<T>, "tp::task does not support reference results");
+
+    public:
+        using promise_type = detail::task_promise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        task() noexcept = default;
+        explicit task(handle_type h) noexcept : h_(h) {}
+        task(task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+        task& operator=(task&& other) noexcept {
+            if(this != &other) {
+                if(h_)
+                    h_.destroy();
+                h_ = std::exchange(other.h_, {});
+            }
+            return *this;
+        }
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        ~task() {
+            if(h_)
+                h_.destroy();
+        }
+
+        [[nodiscard]] bool valid() const noexcept { return static_cast<bool>(h_); }
+        [[nodiscard]] bool done() const noexcept { return !h_ || h_.done(); }
+
+        auto operator co_await() && noexcept { return awaiter{h_}; }
+        auto operator co_await() & noexcept { return awaiter{h_}; }
+
+    private:
+        struct awaiter {
+            handle_type h_;
+
+            [[nodiscard]] bool await_ready() const noexcept { return !h_ || h_.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                h_.promise().continuation_ = awaiting;
+                return h_;  // 对称转移：直接开始执行被等待的任务
+            }
+            T await_resume() { return h_.promise().result(); }
+        };
+
+        handle_type h_;
+    };
+
+    namespace detail {
+        template <typename T>
+        task<T> task_promise<T>::get_return_object() noexcept {
+            return task<T>{std::coroutine_handle<task_promise<T>>::from_promise(*this)};
+        }
+
+        inline task<void> task_promise<void>::get_return_object() noexcept {
+            return task<void>{std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+        }
+
+        // sync_wait 用的协程：结束时（已挂起后）才通知等待线程，等待线程随后销毁协程帧
+        struct blocking_task {
+            struct promise_type {
+                std::mutex* mtx = nullptr;
+                std::condition_variable* cv = nullptr;
+                bool* done = nullptr;
+
+                blocking_task get_return_object() noexcept {
+                    return blocking_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+                auto final_suspend() const noexcept {
+                    struct notifier {
+                        [[nodiscard]] bool await_ready() const noexcept { return false; }
+                        void await_suspend(std::coroutine_handle<promise_type> h) const noexcept {
+                            auto& p = h.promise();
+                            std::lock_guard<std::mutex> lock(*p.mtx);
+                            *p.done = true;
+                            p.cv->notify_all();
+                        }
+                        void await_resume() const noexcept {}
+                    };
+                    return notifier{};
+                }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+
+            std::coroutine_handle<promise_type> h;
+        };
+
+        // spawn 用的协程：不需要任何人等待，结束后自行销毁
+        struct detached_task {
+            struct promise_type {
+                detached_task get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept {}  // 被 spawn 的任务抛出的异常被丢弃
+            };
+        };
+
+        template <typename T>
+        blocking_task make_sync_waiter(task<T>& t, std::optional<T>& value, std::exception_ptr& error) {
+            try {
+                value.emplace(co_await t);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        inline blocking_task make_sync_waiter(task<void>& t, std::exception_ptr& error) {
+            try {
+                co_await t;
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        inline detached_task run_detached(WorkBranch& br, task<void> t) {
+            co_await br.schedule();
+            co_await std::move(t);
+        }
+    }
+
+    // 在当前（非协程）线程上阻塞等待 t 完成，用于 main 等同步代码和协程之间的衔接
+    template <typename T>
+    T sync_wait(task<T> t) {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool done = false;
+        std::exception_ptr error;
+        [[maybe_unused]] std::conditional_t<std::is_void_v<T>, int, std::optional<T>> value{};
+
+        detail::blocking_task waiter = [&] {
+            if constexpr (std::is_void_v<T>)
+                return detail::make_sync_waiter(t, error);
+            else
+                return detail::make_sync_waiter(t, value, error);
+        }();
+        waiter.h.promise().mtx = &mtx;
+        waiter.h.promise().cv = &cv;
+        waiter.h.promise().done = &done;
+        waiter.h.resume();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return done; });
+        }
+        waiter.h.destroy();
+        if(error)
+            std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*value);
+    }
+
+    // 在 br 上启动 t，不等待其完成；t 的协程帧在完成后自动释放
+    inline void spawn(WorkBranch& br, task<void> t) {
+        detail::run_detached(br, std::move(t));
+    }
+
+}
+
+#endif //COROUTINE_H
@@ -0,0 +1,471 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Cancellation.h"
+#include "Parker.h"
+#include "Task.h"
+#include "Utility.h"
+#include "WorkBranch.h"
+
+namespace tp {
+
+    template <typename R>
+    class future;
+
+    namespace detail {
+        // future 的共享状态：值、异常、一个后续任务，以及一个原子状态字。
+        // 生产者写入结果后把状态置为 ready；then 写入后续任务后把状态置为 has_continuation，
+        // 两边谁后到谁负责调度后续任务，全程不加锁。引用计数是侵入式的，整个状态只分配一次。
+        template <typename R>
+        class future_state {
+            enum : int { empty = 0, has_continuation = 1, ready = 2 };
+
+            std::atomic<int> status_{empty};
+            std::atomic<int> refs_{0};
+            WorkBranch* br_ = nullptr;  // 后续任务在这个分支上执行
+            std::pmr::memory_resource* mr_ = nullptr;  // 本状态从这里分配
+            std::conditional_t<std::is_void_v<R>, bool, std::optional<R>> value_{};
+            std::exception_ptr error_;
+            Task continuation_;
+            bool inline_continuation_ = false;  // 在完成结果的线程上直接执行，供 when_all/when_any 内部使用
+            bool abandoned_ = false;  // 任务未执行就被销毁（分支已析构），后续任务不能再提交到分支
+
+            future_state(WorkBranch* br, std::pmr::memory_resource* mr) noexcept : br_(br), mr_(mr) {}
+
+        public:
+            // 从分支的内存资源分配（没有分支时用 default_slab_resource()），稳定状态下不经过通用分配器
+            static future_state* create(WorkBranch* br) {
+                std::pmr::memory_resource* mr = br ? br->memory_resource() : default_slab_resource();
+                return ::new(mr->allocate(sizeof(future_state), alignof(future_state))) future_state(br, mr);
+            }
+
+            void add_ref() noexcept { refs_.fetch_add(1, std::memory_order_relaxed); }
+            void release() noexcept {
+                if(refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::pmr::memory_resource* mr = mr_;
+                    this->~future_state();
+                    mr->deallocate(this, sizeof(future_state), alignof(future_state));
+                }
+            }
+
+            [[nodiscard]] WorkBranch* branch() const noexcept { return br_; }
+            [[nodiscard]] bool is_ready() const noexcept { return status_.load(std::memory_order_acquire) == ready; }
+            [[nodiscard]] const std::exception_ptr& error() const noexcept { return error_; }
+            [[nodiscard]] bool abandoned() const noexcept { return abandoned_; }
+
+            template <typename ...V>
+            void set_value(V&& ...v) {
+                if constexpr (std::is_void_v<R>)
+                    value_ = true;
+                else
+                    value_.emplace(std::forward<V>(v)...);
+                publish();
+            }
+
+            void set_exception(std::exception_ptr e, bool abandoned = false) {
+                error_ = std::move(e);
+                abandoned_ = abandoned;
+                publish();
+            }
+
+            // 取出结果，只能在 ready 之后调用一次
+            R take() {
+                if(error_)
+                    std::rethrow_exception(error_);
+                if constexpr (!std::is_void_v<R>)
+                    return std::move(*value_);
+            }
+
+            void set_continuation(Task&& cont, bool run_inline);
+            bool block(const std::chrono::steady_clock::time_point* deadline);
+            Task take_continuation() noexcept { return std::move(continuation_); }
+
+        private:
+            void publish() {
+                if(status_.exchange(ready, std::memory_order_acq_rel) == has_continuation)
+                    dispatch();
+            }
+
+            void dispatch();
+        };
+
+        // 侵入式引用计数指针
+        template <typename R>
+        class state_ptr {
+            future_state<R>* p_ = nullptr;
+        public:
+            state_ptr() noexcept = default;
+            explicit state_ptr(future_state<R>* p) noexcept : p_(p) { if(p_) p_->add_ref(); }
+            state_ptr(const state_ptr& o) noexcept : p_(o.p_) { if(p_) p_->add_ref(); }
+            state_ptr(state_ptr&& o) noexcept : p_(std::exchange(o.p_, nullptr)) {}
+            state_ptr& operator=(state_ptr o) noexcept { std::swap(p_, o.p_); return *this; }
+            ~state_ptr() { if(p_) p_->release(); }
+
+            future_state<R>* get() const noexcept { return p_; }
+            future_state<R>* operator->() const noexcept { return p_; }
+            explicit operator bool() const noexcept { return p_ != nullptr; }
+        };
+
+        // 执行后续任务；若没执行就被销毁（例如分支析构时丢弃了队列），也要清掉后续任务，打破引用环
+        template <typename R>
+        struct continuation_runner {
+            state_ptr<R> st;
+            void operator()() {
+                Task cont = st->take_continuation();
+                cont();
+            }
+            continuation_runner(state_ptr<R> s) noexcept : st(std::move(s)) {}
+            continuation_runner(continuation_runner&&) noexcept = default;
+            ~continuation_runner() {
+                if(st)
+                    st->take_continuation();
+            }
+        };
+
+        template <typename R>
+        void future_state<R>::set_continuation(Task&& cont, bool run_inline) {
+            continuation_ = std::move(cont);
+            inline_continuation_ = run_inline;
+            int expected = empty;
+            if(!status_.compare_exchange_strong(expected, has_continuation, std::memory_order_acq_rel, std::memory_order_acquire))
+                dispatch();  // 结果已经就绪
+        }
+
+        // 用一个内联的后续任务唤醒等待者；超时时若后续任务还没被取走就撤回，之后仍可以 then 或再次等待
+        template <typename R>
+        bool future_state<R>::block(const std::chrono::steady_clock::time_point* deadline) {
+            std::mutex mtx;
+            std::condition_variable cv;
+            bool done = false;
+            set_continuation([&mtx, &cv, &done] {
+                std::lock_guard<std::mutex> lock(mtx);
+                done = true;
+                cv.notify_all();
+            }, true);
+            std::unique_lock<std::mutex> lock(mtx);
+            if(!deadline) {
+                cv.wait(lock, [&done] { return done; });
+                return true;
+            }
+            if(cv.wait_until(lock, *deadline, [&done] { return done; }))
+                return true;
+            int expected = has_continuation;
+            if(status_.compare_exchange_strong(expected, empty, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                continuation_.reset();
+                inline_continuation_ = false;
+                return false;
+            }
+            cv.wait(lock, [&done] { return done; });  // 生产者已经在通知的路上
+            return true;
+        }
+
+        template <typename R>
+        void future_state<R>::dispatch() {
+            if(inline_continuation_ || abandoned_ || br_ == nullptr) {
+                state_ptr<R> keep(this);
+                Task cont = take_continuation();
+                cont();
+            }
+            else
+                br_->dispatch([run = continuation_runner<R>(state_ptr<R>(this))]() mutable { run(); });
+        }
+
+        // 生产者一侧：只能设置一次结果；没有设置就被销毁时以 broken_promise 结束
+        template <typename R>
+        class promise_ref {
+            state_ptr<R> st_;
+            bool done_ = false;
+        public:
+            explicit promise_ref(state_ptr<R> st) noexcept : st_(std::move(st)) {}
+            promise_ref(promise_ref&& o) noexcept : st_(std::move(o.st_)), done_(std::exchange(o.done_, true)) {}
+            promise_ref& operator=(promise_ref&&) = delete;
+            ~promise_ref() {
+                if(st_ && !done_)
+                    st_->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)), true);
+            }
+
+            template <typename F>
+            void run(F&& fn) {
+                done_ = true;
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        std::forward<F>(fn)();
+                        st_->set_value();
+                    } else
+                        st_->set_value(std::forward<F>(fn)());
+                } catch (...) {
+                    st_->set_exception(std::current_exception());
+                }
+            }
+
+            template <typename ...V>
+            void set_value(V&& ...v) {
+                done_ = true;
+                st_->set_value(std::forward<V>(v)...);
+            }
+
+            void set_exception(std::exception_ptr e, bool abandoned = false) {
+                done_ = true;
+                st_->set_exception(std::move(e), abandoned);
+            }
+        };
+
+        template <typename R, typename F>
+        struct then_result_impl { using type = result_of<F, R>; };
+        template <typename F>
+        struct then_result_impl<void, F> { using type = result_of<F>; };
+        template <typename R, typename F>
+        using then_result = typename then_result_impl<R, F>::type;
+    }
+
+    // 轻量的 future：结果就绪后通过 then 在同一分支上调度后续任务，不占用任何线程等待
+    template <typename R>
+    class future {
+        template <typename> friend class future;
+        template <typename T> friend auto when_all(std::vector<future<T>> fs);
+        template <typename T> friend auto when_any(std::vector<future<T>> fs);
+
+        detail::state_ptr<R> st_;
+
+    public:
+        future() noexcept = default;
+        explicit future(detail::state_ptr<R> st) noexcept : st_(std::move(st)) {}
+        future(future&&) noexcept = default;
+        future& operator=(future&&) noexcept = default;
+        future(const future&) = delete;
+        future& operator=(const future&) = delete;
+
+        [[nodiscard]] bool valid() const noexcept { return static_cast<bool>(st_); }
+        [[nodiscard]] bool is_ready() const { return check()->is_ready(); }
+
+        // 阻塞等待：先短暂自旋，仍未就绪则挂一个通知用的后续任务并在条件变量上休眠
+        void wait() const {
+            auto* st = check();
+            if(!spin(st))
+                st->block(nullptr);
+        }
+
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+            auto* st = check();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+            return spin(st) || st->block(&deadline);
+        }
+
+        // 取出结果（或重新抛出异常），之后 future 失效
+        R get() {
+            wait();
+            detail::state_ptr<R> st = std::move(st_);
+            return st->take();
+        }
+
+        // 结果就绪后在同一分支上执行 fn(value)（R 为 void 时为 fn()），返回 fn 结果的 future；
+        // 本 future 的异常直接传给返回的 future，不调用 fn。调用后本 future 失效
+        template <typename F, typename U = detail::then_result<R, F>>
+        future<U> then(F&& fn) {
+            check();
+            detail::state_ptr<R> src = std::move(st_);
+            detail::state_ptr<U> next(detail::future_state<U>::create(src->branch()));
+            detail::future_state<R>* raw = src.get();
+            raw->set_continuation(
+                [src = std::move(src), out = detail::promise_ref<U>(next), fn = std::forward<F>(fn)]() mutable {
+                    if(src->error())
+                        out.set_exception(src->error(), src->abandoned());
+                    else if constexpr (std::is_void_v<R>)
+                        out.run(fn);
+                    else
+                        out.run([&] { return fn(src->take()); });
+                }, false);
+            return future<U>(std::move(next));
+        }
+
+    private:
+        detail::future_state<R>* check() const {
+            if(!st_)
+                throw std::future_error(std::future_errc::no_state);
+            return st_.get();
+        }
+
+        // 只做很短的自旋：让出时间片会把 CPU 让给刚执行完任务、仍在自旋的工作线程，反而推迟被唤醒
+        static bool spin(detail::future_state<R>* st) {
+            for(unsigned spins = 0; spins < 64; ++spins) {
+                if(st->is_ready())
+                    return true;
+                cpu_relax();
+            }
+            return st->is_ready();
+        }
+    };
+
+    // 在 br 上执行 fn，返回 tp::future；整个提交只分配一次共享状态
+    template <
+        typename T = normal,
+        typename F,
+        typename R = result_of<F>,
+        typename = std::enable_if_t<is_queue_tag_v<T>>
+    >
+    future<R> async(WorkBranch& br, F&& fn) {
+        detail::state_ptr<R> st(detail::future_state<R>::create(&br));
+        br.submit<T>([out = detail::promise_ref<R>(st), fn = std::forward<F>(fn)]() mutable {
+            out.run(fn);
+        });
+        return future<R>(std::move(st));
+    }
+
+    // 可取消的 async：返回 {tp::future, cancel_handle}，fn 可以是 fn() 或 fn(stop_token)；
+    // 开始执行前被取消时不执行 fn，future（以及挂在它后面的 then）以 task_cancelled 结束
+    template <
+        typename T = normal,
+        typename F,
+        typename R = detail::token_result_t<F>,
+        typename = std::enable_if_t<is_queue_tag_v<T>>
+    >
+    cancellable<future<R>> async_cancellable(WorkBranch& br, F&& fn) {
+        detail::state_ptr<R> st(detail::future_state<R>::create(&br));
+        auto cs = std::allocate_shared<detail::cancel_state>(std::pmr::polymorphic_allocator<detail::cancel_state>(br.memory_resource()));
+        cancel_handle handle(cs);
+        br.submit<T>([out = detail::promise_ref<R>(st), cs = std::move(cs), fn = std::forward<F>(fn)]() mutable {
+            if(!cs->begin())
+                out.set_exception(std::make_exception_ptr(task_cancelled{}));
+            else
+                out.run([&]() -> R { return detail::invoke_with_token(fn, cs); });
+        });
+        return {future<R>(std::move(st)), std::move(handle)};
+    }
+
+    template <typename R>
+    future<std::decay_t<R>> make_ready_future(R&& value, WorkBranch* br = nullptr) {
+        detail::state_ptr<std::decay_t<R>> st(detail::future_state<std::decay_t<R>>::create(br));
+        st->set_value(std::forward<R>(value));
+        return future<std::decay_t<R>>(std::move(st));
+    }
+
+    inline future<void> make_ready_future(WorkBranch* br = nullptr) {
+        detail::state_ptr<void> st(detail::future_state<void>::create(br));
+        st->set_value();
+        return future<void>(std::move(st));
+    }
+
+    // 全部完成后就绪，结果按输入顺序排列（T 为 void 时返回 future<void>）；任一输入失败则以第一个异常结束
+    template <typename T>
+    auto when_all(std::vector<future<T>> fs) {
+        using V = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+        WorkBranch* br = fs.empty() ? nullptr : fs.front().st_->branch();
+        detail::state_ptr<V> st(detail::future_state<V>::create(br));
+        if(fs.empty()) {
+            if constexpr (std::is_void_v<T>)
+                st->set_value();
+            else
+                st->set_value(std::vector<T>{});
+            return future<V>(std::move(st));
+        }
+
+        struct join_state {
+            std::conditional_t<std::is_void_v<T>, char, std::vector<std::optional<T>>> results;
+            std::atomic<std::size_t> remaining;
+            std::atomic<bool> settled{false};
+            detail::promise_ref<V> out;
+            join_state(std::size_t n, detail::state_ptr<V> s) : remaining(n), out(std::move(s)) {
+                if constexpr (!std::is_void_v<T>)
+                    results.resize(n);
+            }
+        };
+        auto join = std::make_shared<join_state>(fs.size(), st);
+        for(std::size_t i = 0; i < fs.size(); ++i) {
+            detail::state_ptr<T> src = std::move(fs[i].st_);
+            detail::future_state<T>* raw = src.get();
+            raw->set_continuation([join, i, src = std::move(src)]() mutable {
+                if(src->error()) {
+                    if(!join->settled.exchange(true))
+                        join->out.set_exception(src->error(), src->abandoned());
+                    return;
+                }
+                if constexpr (!std::is_void_v<T>)
+                    join->results[i].emplace(src->take());
+                if(join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && !join->settled.exchange(true)) {
+                    if constexpr (std::is_void_v<T>)
+                        join->out.set_value();
+                    else {
+                        std::vector<T> all;
+                        all.reserve(join->results.size());
+                        for(auto& each : join->results)
+                            all.emplace_back(std::move(*each));
+                        join->out.set_value(std::move(all));
+                    }
+                }
+            }, true);
+        }
+        return future<V>(std::move(st));
+    }
+
+    template <typename T>
+    auto when_all(futures<T, future>&& fs) {
+        std::vector<future<T>> v;
+        v.reserve(fs.size());
+        for(auto& f : fs)
+            v.emplace_back(std::move(f));
+        return when_all(std::move(v));
+    }
+
+    // 任一输入完成即就绪：结果为 (下标, 值)，T 为 void 时只有下标；第一个完成的输入失败则以其异常结束
+    template <typename T>
+    auto when_any(std::vector<future<T>> fs) {
+        using V = std::conditional_t<std::is_void_v<T>, std::size_t, std::pair<std::size_t, T>>;
+        if(fs.empty())
+            throw std::invalid_argument("workspace: when_any needs at least one future");
+        detail::state_ptr<V> st(detail::future_state<V>::create(fs.front().st_->branch()));
+
+        struct race_state {
+            std::atomic<bool> settled{false};
+            detail::promise_ref<V> out;
+            explicit race_state(detail::state_ptr<V> s) : out(std::move(s)) {}
+        };
+        auto race = std::make_shared<race_state>(st);
+        for(std::size_t i = 0; i < fs.size(); ++i) {
+            detail::state_ptr<T> src = std::move(fs[i].st_);
+            detail::future_state<T>* raw = src.get();
+            raw->set_continuation([race, i, src = std::move(src)]() mutable {
+                if(race->settled.exchange(true))
+                    return;
+                if(src->error())
+                    race->out.set_exception(src->error(), src->abandoned());
+                else if constexpr (std::is_void_v<T>)
+                    race->out.set_value(i);
+                else
+                    race->out.set_value(i, src->take());
+            }, true);
+        }
+        return future<V>(std::move(st));
+    }
+
+    template <typename T>
+    auto when_any(futures<T, future>&& fs) {
+        std::vector<future<T>> v;
+        v.reserve(fs.size());
+        for(auto& f : fs)
+            v.emplace_back(std::move(f));
+        return when_any(std::move(v));
+    }
+
+}
+
+#endif //FUTURE_H
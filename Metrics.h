@@ -0,0 +1,156 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tp {
+
+    // 排队延迟直方图：第 i 个桶统计 [2^i, 2^(i+1)) 纳秒的等待，最后一个桶包含所有更长的等待
+    constexpr std::size_t latency_buckets = 32;
+
+    // 一个线程的运行统计快照。时间和排队延迟只在 branch_options::collect_timing 打开时统计
+    struct worker_metrics {
+        std::uint64_t tasks_executed = 0;
+        std::uint64_t steal_attempts = 0;
+        std::uint64_t steals = 0;
+        std::uint64_t exceptions = 0;   // make_task_wrapper 捕获的异常数
+        std::uint64_t tasks_cancelled = 0;  // 出队时发现已取消而丢弃的任务，也计入 tasks_executed
+        std::uint64_t busy_ns = 0;      // 执行任务
+        std::uint64_t idle_ns = 0;      // 自旋等待任务
+        std::uint64_t parked_ns = 0;    // 在 Parker 上休眠
+        std::array<std::uint64_t, latency_buckets> queue_wait{};  // 从提交到开始执行
+
+        worker_metrics& operator+=(const worker_metrics& o) {
+            tasks_executed += o.tasks_executed;
+            steal_attempts += o.steal_attempts;
+            steals += o.steals;
+            exceptions += o.exceptions;
+            tasks_cancelled += o.tasks_cancelled;
+            busy_ns += o.busy_ns;
+            idle_ns += o.idle_ns;
+            parked_ns += o.parked_ns;
+            for(std::size_t i = 0; i < latency_buckets; ++i)
+                queue_wait[i] += o.queue_wait[i];
+            return *this;
+        }
+
+        // 由直方图估算的排队延迟分位数（所在桶的上界），没有样本时为 0
+        [[nodiscard]] std::uint64_t queue_wait_percentile(double q) const {
+            std::uint64_t n = 0;
+            for(auto c : queue_wait)
+                n += c;
+            if(n == 0)
+                return 0;
+            auto target = static_cast<std::uint64_t>(q * static_cast<double>(n - 1)) + 1;
+            std::uint64_t seen = 0;
+            for(std::size_t i = 0; i < latency_buckets; ++i) {
+                seen += queue_wait[i];
+                if(seen >= target)
+                    return std::uint64_t(1) << (i + 1);
+            }
+            return std::uint64_t(1) << latency_buckets;
+        }
+    };
+
+    // 整个分支的统计快照
+    struct branch_metrics {
+        std::vector<worker_metrics> workers;  // 每个线程上下文一项，已退出线程的上下文被新线程复用，统计累加
+        worker_metrics external;  // 非本分支线程通过 run_pending_task 帮忙执行的任务（只统计任务数和异常数）
+        worker_metrics total;     // 以上各项之和
+        std::size_t in_flight = 0;  // 排队中 + 执行中的任务数
+        std::uint64_t rejected = 0;  // 因队列已满（branch_options::capacity）被拒绝的任务
+        std::uint64_t dropped = 0;   // 被 overflow_policy::drop_oldest 丢弃的任务
+        std::uint64_t errors_dropped = 0;  // 错误队列已满或 error_capacity 为 0 而丢弃的未捕获异常
+    };
+
+    namespace detail {
+        inline std::uint64_t now_ns() noexcept {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // 单写者计数器：只有所属线程写入，用 load + store 代替原子读改写；其他线程随时可以无锁读取
+        class relaxed_counter {
+            std::atomic<std::uint64_t> v_{0};
+        public:
+            void add(std::uint64_t n = 1) noexcept { v_.store(v_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+            [[nodiscard]] std::uint64_t get() const noexcept { return v_.load(std::memory_order_relaxed); }
+        };
+
+        // 每个线程上下文一份，按缓存行对齐，避免相邻线程的计数器伪共享
+        struct alignas(64) metrics_block {
+            relaxed_counter tasks_executed;
+            relaxed_counter steal_attempts;
+            relaxed_counter steals;
+            relaxed_counter tasks_cancelled;
+            relaxed_counter busy_ns;
+            relaxed_counter parked_ns;
+            relaxed_counter alive_ns;  // 已退出的线程使用本上下文的累计时长
+            std::atomic<std::uint64_t> attached_at{0};  // 当前线程开始使用本上下文的时刻，0 表示空闲
+            std::atomic<std::uint64_t> parked_at{0};    // 正在休眠时为开始休眠的时刻，快照中计入进行中的休眠
+            std::atomic<std::uint64_t> exceptions{0};
+            std::array<relaxed_counter, latency_buckets> queue_wait;
+
+            void record_wait(std::uint64_t ns) noexcept {
+                std::size_t b = 0;
+                while(ns > 1 && b + 1 < latency_buckets) {
+                    ns >>= 1;
+                    ++b;
+                }
+                queue_wait[b].add();
+            }
+
+            void attach(bool timing) noexcept {
+                attached_at.store(timing ? now_ns() : 0, std::memory_order_relaxed);
+            }
+
+            void park_begin() noexcept { parked_at.store(now_ns(), std::memory_order_relaxed); }
+
+            void park_end() noexcept {
+                std::uint64_t t = parked_at.exchange(0, std::memory_order_relaxed);
+                parked_ns.add(now_ns() - t);
+            }
+
+            void detach() noexcept {
+                std::uint64_t t = attached_at.exchange(0, std::memory_order_relaxed);
+                if(t)
+                    alive_ns.add(now_ns() - t);
+            }
+
+            [[nodiscard]] worker_metrics snapshot(std::uint64_t now) const noexcept {
+                worker_metrics m;
+                m.tasks_executed = tasks_executed.get();
+                m.steal_attempts = steal_attempts.get();
+                m.steals = steals.get();
+                m.exceptions = exceptions.load(std::memory_order_relaxed);
+                m.tasks_cancelled = tasks_cancelled.get();
+                m.busy_ns = busy_ns.get();
+                std::uint64_t p = parked_at.load(std::memory_order_relaxed);
+                m.parked_ns = parked_ns.get() + (p && now > p ? now - p : 0);
+                std::uint64_t t = attached_at.load(std::memory_order_relaxed);
+                std::uint64_t alive = alive_ns.get() + (t && now > t ? now - t : 0);
+                std::uint64_t used = m.busy_ns + m.parked_ns;
+                m.idle_ns = alive > used ? alive - used : 0;
+                for(std::size_t i = 0; i < latency_buckets; ++i)
+                    m.queue_wait[i] = queue_wait[i].get();
+                return m;
+            }
+        };
+
+        // 当前线程正在为哪个统计块执行任务，由 WorkBranch 在执行任务前后设置
+        inline thread_local metrics_block* current_metrics = nullptr;
+        inline thread_local std::atomic<std::uint64_t>* current_exceptions = nullptr;
+    }
+
+}
+
+#endif //METRICS_H
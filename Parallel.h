@@ -0,0 +1,166 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "WorkBranch.h"
+
+namespace tp {
+    namespace detail {
+        // 把 [begin, end) 按 grain 切成若干块，递归二分：每次把右半部分提交给分支，自己继续处理左半部分。
+        // 作业对象放在调用者的栈上，任务只捕获指针和块号，不为每个块分配 future；
+        // 调用者也参与执行，等待时帮分支执行排队中的任务
+        template <typename Index, typename Body>
+        class range_job {
+            WorkBranch& br_;
+            const Index begin_;
+            const Index end_;
+            const Index grain_;
+            Body& body_;  // body(chunk_begin, chunk_end, chunk_id)
+
+            std::atomic<std::size_t> pending_;  // 尚未完成的块数
+            std::atomic<bool> failed_{false};
+            std::exception_ptr error_;
+
+            std::mutex mtx_;
+            std::condition_variable done_cv_;
+            bool done_ = false;
+
+        public:
+            range_job(WorkBranch& br, Index begin, Index end, Index grain, Body& body)
+                : br_(br), begin_(begin), end_(end), grain_(grain), body_(body)
+                , pending_(num_chunks()) {}
+
+            std::size_t num_chunks() const {
+                auto n = static_cast<std::size_t>(end_ - begin_);
+                auto g = static_cast<std::size_t>(grain_);
+                return (n + g - 1) / g;
+            }
+
+            void run() {
+                if(std::size_t n = num_chunks()) {
+                    split(0, n);
+                    wait();
+                }
+                if(error_)
+                    std::rethrow_exception(error_);
+            }
+
+        private:
+            void split(std::size_t lo, std::size_t hi) {
+                while(hi - lo > 1) {
+                    std::size_t mid = lo + (hi - lo) / 2;
+                    br_.dispatch([this, mid, hi] { split(mid, hi); });
+                    hi = mid;
+                }
+                exec(lo);
+            }
+
+            void exec(std::size_t c) {
+                if(!failed_.load(std::memory_order_relaxed)) {
+                    Index b = begin_ + static_cast<Index>(c * static_cast<std::size_t>(grain_));
+                    Index e = static_cast<std::size_t>(end_ - b) > static_cast<std::size_t>(grain_) ? b + grain_ : end_;
+                    try {
+                        body_(b, e, c);
+                    } catch (...) {
+                        if(!failed_.exchange(true))  // 只保留第一个异常，其余的块直接跳过
+                            error_ = std::current_exception();
+                    }
+                }
+                // 最后一块完成时在锁内通知；此后任何任务都不再访问作业对象
+                if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    done_ = true;
+                    done_cv_.notify_all();
+                    br_.wake_helpers();  // wait() 中休眠的线程
+                }
+            }
+
+            // 最后一块在锁内置位 done_：计数归零后再等它离开临界区，作业对象才能销毁
+            void wait() {
+                br_.help_until([this] { return pending_.load(std::memory_order_acquire) == 0; });
+                std::unique_lock<std::mutex> lock(mtx_);
+                done_cv_.wait(lock, [this] { return done_; });
+            }
+        };
+
+        template <typename Index>
+        Index auto_grain(WorkBranch& br, Index begin, Index end, Index grain) {
+            if(grain > 0)
+                return grain;
+            // 每个线程大约分到 8 块，既能均衡负载又不至于切得过碎
+            auto n = static_cast<std::size_t>(end - begin);
+            auto parts = 8 * (br.num_workers() + 1);
+            return static_cast<Index>(std::max<std::size_t>(1, n / parts));
+        }
+
+        template <typename Index, typename Body>
+        void run_range(WorkBranch& br, Index begin, Index end, Index grain, Body&& body) {
+            static_assert(std::is_integral_v<Index>, "tp: parallel algorithms take an integral index range");
+            if(!(begin < end))
+                return;
+            range_job<Index, std::remove_reference_t<Body>> job(br, begin, end, auto_grain(br, begin, end, grain), body);
+            job.run();
+        }
+    }
+
+    // 对 [begin, end) 中的每个下标调用 fn(i)；fn 也可以接受 (chunk_begin, chunk_end) 一次处理一整块
+    // grain 为每块的最小下标数，<= 0 时按线程数自动选择
+    template <typename Index, typename F>
+    void parallel_for(WorkBranch& br, Index begin, Index end, Index grain, F&& fn) {
+        detail::run_range(br, begin, end, grain, [&fn](Index b, Index e, std::size_t) {
+            if constexpr (std::is_invocable_v<F&, Index, Index>)
+                fn(b, e);
+            else
+                for(Index i = b; i < e; ++i)
+                    fn(i);
+        });
+    }
+
+    // 计算 op(...op(op(identity, fn(begin)), fn(begin+1))..., fn(end-1))
+    // op 需满足结合律；各块的部分结果按块顺序合并，因此不要求交换律
+    template <typename Index, typename T, typename F, typename Op>
+    T parallel_reduce(WorkBranch& br, Index begin, Index end, Index grain, T identity, F&& fn, Op&& op) {
+        if(!(begin < end))
+            return identity;
+        grain = detail::auto_grain(br, begin, end, grain);
+        auto n = static_cast<std::size_t>(end - begin);
+        std::vector<T> partial((n + static_cast<std::size_t>(grain) - 1) / static_cast<std::size_t>(grain), identity);
+        detail::run_range(br, begin, end, grain, [&](Index b, Index e, std::size_t c) {
+            T acc = identity;
+            for(Index i = b; i < e; ++i)
+                acc = op(std::move(acc), fn(i));
+            partial[c] = std::move(acc);
+        });
+        T res = std::move(identity);
+        for(auto& each : partial)
+            res = op(std::move(res), std::move(each));
+        return res;
+    }
+
+    // *(out + i) = fn(*(first + i))，first 和 out 都需要是随机访问迭代器
+    template <typename InIt, typename OutIt, typename F>
+    OutIt parallel_transform(WorkBranch& br, InIt first, InIt last, OutIt out, std::ptrdiff_t grain, F&& fn) {
+        std::ptrdiff_t n = std::distance(first, last);
+        parallel_for(br, std::ptrdiff_t(0), n, grain, [&](std::ptrdiff_t b, std::ptrdiff_t e) {
+            auto in = first + b;
+            auto dst = out + b;
+            for(std::ptrdiff_t i = b; i < e; ++i, ++in, ++dst)
+                *dst = fn(*in);
+        });
+        return out + n;
+    }
+}
+
+#endif //PARALLEL_H
@@ -0,0 +1,129 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef PARKER_H
+#define PARKER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "Trace.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace tp {
+
+    // 自旋等待时的 CPU 提示，降低功耗并让出流水线给超线程
+    inline void cpu_relax() noexcept {
+#if defined(_MSC_VER)
+        _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield" ::: "memory");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // 空闲线程的休眠/唤醒器
+    // 生产者只在有线程休眠时才加锁通知，无人休眠时 unpark 只是一次原子读
+    class Parker {
+        std::atomic<std::size_t> sleepers_{0};
+        std::uint64_t epoch_ = 0;   // 每次唤醒递增，由 mtx_ 保护
+        std::mutex mtx_;
+        std::condition_variable cv_;
+
+    public:
+        Parker() = default;
+        Parker(const Parker&) = delete;
+        Parker& operator=(const Parker&) = delete;
+
+        // ready 必须在无锁状态下可调用，用于休眠前的二次检查（防止丢失唤醒）
+        template <typename Pred>
+        void park(Pred&& ready) {
+            park_impl(ready, [this](std::unique_lock<std::mutex>& lock, std::uint64_t epoch) {
+                cv_.wait(lock, [&] { return epoch_ != epoch; });
+            });
+        }
+
+        // 同 park，但最多休眠 timeout，用于唤醒方无法通知到的等待条件
+        template <typename Pred, typename Rep, typename Period>
+        void park_for(Pred&& ready, const std::chrono::duration<Rep, Period>& timeout) {
+            park_impl(ready, [&](std::unique_lock<std::mutex>& lock, std::uint64_t epoch) {
+                cv_.wait_for(lock, timeout, [&] { return epoch_ != epoch; });
+            });
+        }
+
+        void unpark_one() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(sleepers_.load(std::memory_order_seq_cst) == 0)
+                return;
+            TP_TRACE(trace::event::unpark, 1);
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                ++epoch_;
+            }
+            cv_.notify_one();
+        }
+
+        // 唤醒至多 n 个休眠线程
+        void unpark(std::size_t n) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::size_t sleepers = sleepers_.load(std::memory_order_seq_cst);
+            if(sleepers == 0 || n == 0)
+                return;
+            TP_TRACE(trace::event::unpark, n);
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                ++epoch_;
+            }
+            if(n >= sleepers)
+                cv_.notify_all();
+            else
+                while(n--)
+                    cv_.notify_one();
+        }
+
+        void unpark_all() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(sleepers_.load(std::memory_order_seq_cst) == 0)
+                return;
+            TP_TRACE(trace::event::unpark, sleepers_.load(std::memory_order_relaxed));
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                ++epoch_;
+            }
+            cv_.notify_all();
+        }
+
+        [[nodiscard]] std::size_t num_sleepers() const {
+            return sleepers_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        template <typename Pred, typename Wait>
+        void park_impl(Pred& ready, Wait&& wait) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            const std::uint64_t epoch = epoch_;
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // 与 unpark 中的栅栏配对，队列本身可以是无锁的
+            lock.unlock();
+            if(!ready()) {
+                lock.lock();
+                wait(lock, epoch);
+            }
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+}
+
+#endif //PARKER_H
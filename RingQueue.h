@@ -0,0 +1,199 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef RINGQUEUE_H
+#define RINGQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "Parker.h"
+
+namespace tp {
+
+    enum class push_status {
+        ok,
+        full  // 环形队列已满，调用者自行决定重试、阻塞还是丢弃
+    };
+
+    // 有界多生产者多消费者无锁队列 (Dmitry Vyukov, "Bounded MPMC queue")
+    // 每个槽位带有序号，生产者和消费者各自只在一个计数器上 CAS，槽位按缓存行对齐避免伪共享
+    template <typename T>
+    class RingQueue {
+        static constexpr std::size_t cache_line = 64;
+
+        struct alignas(cache_line) Slot {
+            std::atomic<std::size_t> seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T* ptr() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+        };
+
+    public:
+        using size_type = std::size_t;
+
+        explicit RingQueue(size_type capacity) {
+            if(capacity < 2)
+                throw std::invalid_argument("workspace: RingQueue capacity must be at least 2");
+            size_type cap = 2;
+            while(cap < capacity)
+                cap <<= 1;
+            mask_ = cap - 1;
+            slots_.reset(new Slot[cap]);
+            for(size_type i = 0; i < cap; ++i)
+                slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        RingQueue(const RingQueue&) = delete;
+        RingQueue& operator=(const RingQueue&) = delete;
+        ~RingQueue() {
+            size_type head = head_.load(std::memory_order_relaxed);
+            for(size_type pos = tail_.load(std::memory_order_relaxed); pos != head; ++pos)
+                slots_[pos & mask_].ptr()->~T();
+        }
+
+        push_status try_push(T&& v) {
+            return try_emplace(std::move(v));
+        }
+
+        push_status try_push(const T& v) {
+            return try_emplace(v);
+        }
+
+        // 用一次 CAS 预留从 head 开始连续空闲的槽位，返回实际写入的个数（0 表示队列已满）
+        // 只移动被写入的元素
+        template <typename It>
+        size_type try_push_bulk(It first, size_type n) {
+            size_type pos = head_.load(std::memory_order_relaxed);
+            while(true) {
+                size_type k = 0;
+                for(; k < n && k <= mask_; ++k) {
+                    size_type seq = slots_[(pos + k) & mask_].seq.load(std::memory_order_acquire);
+                    if(seq != pos + k)
+                        break;
+                }
+                if(k == 0) {
+                    size_type seq = slots_[pos & mask_].seq.load(std::memory_order_acquire);
+                    if(static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos) < 0)
+                        return 0;
+                    pos = head_.load(std::memory_order_relaxed);  // 其他生产者抢先，重试
+                    continue;
+                }
+                if(head_.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                    for(size_type i = 0; i < k; ++i, ++first) {
+                        Slot& slot = slots_[(pos + i) & mask_];
+                        ::new(static_cast<void*>(slot.storage)) T(std::move(*first));
+                        slot.seq.store(pos + i + 1, std::memory_order_release);
+                    }
+                    return k;
+                }
+            }
+        }
+
+        template <typename It>
+        void push_bulk(It first, size_type n) {
+            for(unsigned spins = 0; n > 0; ++spins) {
+                size_type k = try_push_bulk(first, n);
+                if(k == 0) {
+                    backoff(spins);
+                    continue;
+                }
+                std::advance(first, k);
+                n -= k;
+                spins = 0;
+            }
+        }
+
+        bool try_pop(T& v) {
+            size_type pos = tail_.load(std::memory_order_relaxed);
+            while(true) {
+                Slot& slot = slots_[pos & mask_];
+                size_type seq = slot.seq.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+                if(diff == 0) {
+                    if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        v = std::move(*slot.ptr());
+                        slot.ptr()->~T();
+                        slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                    return false;  // 队列为空
+                else
+                    pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 阻塞版本：队列满/空时先自旋再让出时间片
+        void push(T&& v) {
+            for(unsigned spins = 0; try_push(std::move(v)) == push_status::full; ++spins)
+                backoff(spins);
+        }
+
+        void push(const T& v) {
+            for(unsigned spins = 0; try_push(v) == push_status::full; ++spins)
+                backoff(spins);
+        }
+
+        void pop(T& v) {
+            for(unsigned spins = 0; !try_pop(v); ++spins)
+                backoff(spins);
+        }
+
+        // 近似值，并发修改时只作参考
+        [[nodiscard]] size_type size() const noexcept {
+            size_type head = head_.load(std::memory_order_relaxed);
+            size_type tail = tail_.load(std::memory_order_relaxed);
+            return head > tail ? head - tail : 0;
+        }
+
+        [[nodiscard]] size_type capacity() const noexcept {
+            return mask_ + 1;
+        }
+
+    private:
+        template <typename U>
+        push_status try_emplace(U&& v) {
+            size_type pos = head_.load(std::memory_order_relaxed);
+            while(true) {
+                Slot& slot = slots_[pos & mask_];
+                size_type seq = slot.seq.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if(diff == 0) {
+                    if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        ::new(static_cast<void*>(slot.storage)) T(std::forward<U>(v));
+                        slot.seq.store(pos + 1, std::memory_order_release);
+                        return push_status::ok;
+                    }
+                }
+                else if(diff < 0)
+                    return push_status::full;
+                else
+                    pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        static void backoff(unsigned spins) {
+            if(spins < 64)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+
+        std::unique_ptr<Slot[]> slots_;
+        size_type mask_ = 0;
+        alignas(cache_line) std::atomic<size_type> head_{0};  // 下一个写入位置
+        alignas(cache_line) std::atomic<size_type> tail_{0};  // 下一个读取位置
+    };
+
+}
+
+#endif //RINGQUEUE_H
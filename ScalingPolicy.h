@@ -0,0 +1,100 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef SCALINGPOLICY_H
+#define SCALINGPOLICY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace tp {
+
+    // Supervisor 每个周期为一个分支采集的滚动统计，速率和时间为指数滑动平均
+    struct scaling_sample {
+        std::size_t workers = 0;
+        std::size_t min_workers = 0;
+        std::size_t max_workers = 0;
+        std::size_t queued = 0;          // 当前排队的任务数
+        double queued_avg = 0;           // 排队任务数的滑动平均
+        double arrival_rate = 0;         // 每秒提交的任务数
+        double completion_rate = 0;      // 每秒完成的任务数
+        double service_time_ns = 0;      // 单个任务的平均执行时间，0 表示还没有数据
+        double idle_ratio = 0;           // 线程空闲（自旋或休眠）时间的比例，0 ~ 1
+        std::chrono::steady_clock::duration interval{};  // 距上一次采样的时间
+        std::chrono::steady_clock::time_point now{};
+    };
+
+    // 扩缩容策略：根据采样返回线程数的变化量（正数扩容，负数缩容），结果由 Supervisor 限制在 [min, max] 之内
+    // Supervisor 为每个分支创建一个策略实例，实例可以保存自己的历史状态
+    class ScalingPolicy {
+    public:
+        virtual ~ScalingPolicy() = default;
+        virtual long decide(const scaling_sample& s) = 0;
+    };
+
+    struct hysteresis_options {
+        std::chrono::microseconds latency_slo{std::chrono::milliseconds(5)};  // 目标排队延迟
+        double target_utilization = 0.8;    // 稳态下希望线程忙碌的比例
+        double scale_down_fraction = 0.25;  // 预计排队延迟低于 slo 的这个比例，且足够空闲时才考虑缩容
+        double idle_threshold = 0.5;
+        unsigned up_ticks = 1;              // 连续多少个周期满足条件才扩容 / 缩容
+        unsigned down_ticks = 4;
+        std::chrono::milliseconds up_cooldown{1000};     // 两次扩容的最小间隔
+        std::chrono::milliseconds down_cooldown{10000};  // 任意一次调整之后，多久才允许缩容
+        std::size_t max_step_up = 4;        // 每次最多增加 / 减少的线程数
+        std::size_t max_step_down = 1;
+    };
+
+    // 默认策略：扩容和缩容使用相距较远的两个阈值（滞回），并各自有冷却时间，
+    // 突发负载下线程的创建/销毁频率有上界，同时尽量让预计排队延迟不超过 latency_slo
+    class HysteresisPolicy : public ScalingPolicy {
+        hysteresis_options opts_;
+        unsigned over_ = 0;   // 连续超标的周期数
+        unsigned under_ = 0;  // 连续富余的周期数
+        std::chrono::steady_clock::time_point last_up_{};
+        std::chrono::steady_clock::time_point last_change_{};
+
+    public:
+        explicit HysteresisPolicy(const hysteresis_options& opts = {}) : opts_(opts) {}
+
+        long decide(const scaling_sample& s) override {
+            const double slo_s = std::chrono::duration<double>(opts_.latency_slo).count();
+            const double service_s = s.service_time_ns / 1e9;
+            const double workers = static_cast<double>(std::max<std::size_t>(s.workers, 1));
+
+            // 预计排队延迟：积压的任务由现有线程并行消化所需的时间；还没有执行时间数据时只看有没有积压
+            double est_wait = service_s > 0 ? static_cast<double>(s.queued) * service_s / workers
+                                            : (s.queued > 0 ? slo_s * 2 : 0);
+            double est_wait_avg = service_s > 0 ? s.queued_avg * service_s / workers : est_wait;
+            // 需要的线程数：稳态负载按目标利用率折算，再加上在 slo 内清空积压所需的线程
+            double want = service_s > 0
+                ? s.arrival_rate * service_s / opts_.target_utilization + static_cast<double>(s.queued) * service_s / slo_s
+                : workers + static_cast<double>(std::min<std::size_t>(s.queued, opts_.max_step_up));
+            auto wanted = static_cast<std::size_t>(std::ceil(std::max(want, 1.0)));
+
+            over_ = est_wait > slo_s ? over_ + 1 : 0;
+            under_ = est_wait_avg < slo_s * opts_.scale_down_fraction && s.idle_ratio > opts_.idle_threshold && wanted < s.workers
+                ? under_ + 1 : 0;
+
+            if(over_ >= opts_.up_ticks && s.workers < s.max_workers && s.now - last_up_ >= opts_.up_cooldown) {
+                std::size_t step = std::clamp<std::size_t>(wanted > s.workers ? wanted - s.workers : 1, 1, opts_.max_step_up);
+                over_ = 0;
+                last_up_ = last_change_ = s.now;
+                return static_cast<long>(step);
+            }
+            if(under_ >= opts_.down_ticks && s.workers > s.min_workers && s.now - last_change_ >= opts_.down_cooldown) {
+                std::size_t step = std::min(opts_.max_step_down, s.workers - std::max(wanted, s.min_workers));
+                under_ = 0;
+                last_change_ = s.now;
+                return -static_cast<long>(step);
+            }
+            return 0;
+        }
+    };
+
+}
+
+#endif //SCALINGPOLICY_H
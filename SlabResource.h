@@ -0,0 +1,236 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef SLABRESOURCE_H
+#define SLABRESOURCE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace tp {
+
+    // 小块内存池：按 16 字节分成若干尺寸等级，每个线程一个本地空闲链表，分配和本线程释放都不加锁。
+    // 本地链表超过两批时把一批交给共享仓库，为空时从仓库取回一批，所以一个线程分配、另一个线程释放的块
+    // （提交者分配、工作线程释放）会成批地回到分配者手里，稳定状态下不再向上游申请内存。
+    // 超过 max_block 或对齐要求超过 max_align_t 的请求直接交给上游。
+    // 其他线程本地缓存中的块在这些线程退出时才归还，所以上游必须比所有用过本对象的线程活得更久
+    class SlabResource : public std::pmr::memory_resource {
+    public:
+        static constexpr std::size_t granularity = alignof(std::max_align_t);
+        static constexpr std::size_t max_block = 512;
+        static constexpr std::size_t num_classes = max_block / granularity;
+        static constexpr std::uint32_t batch_size = 32;  // 线程与仓库之间一次转移的块数
+        static constexpr std::uint32_t chunk_batches = 4;  // 仓库为空时一次向上游申请的批数
+
+    private:
+        struct free_block {
+            free_block* next;
+        };
+
+        struct batch {
+            free_block* head;
+            std::uint32_t count;
+        };
+
+        // 仓库和向上游申请的大块；线程缓存持有它的引用，本对象析构后仍可以安全地归还
+        struct core {
+            std::pmr::memory_resource* upstream;
+            std::mutex mtx;
+            std::vector<batch> depot[num_classes];
+            std::vector<std::pair<void*, std::size_t>> chunks;
+
+            explicit core(std::pmr::memory_resource* up) : upstream(up) {}
+            ~core() {
+                for(auto& c : chunks)
+                    upstream->deallocate(c.first, c.second, granularity);
+            }
+        };
+
+        struct cache {
+            std::shared_ptr<core> owner;
+            free_block* head[num_classes]{};
+            std::uint32_t count[num_classes]{};
+
+            explicit cache(std::shared_ptr<core> c) : owner(std::move(c)) {}
+            cache(const cache&) = delete;
+            cache& operator=(const cache&) = delete;
+            ~cache() {  // 线程退出，本地的块全部还给仓库
+                std::lock_guard<std::mutex> lock(owner->mtx);
+                for(std::size_t c = 0; c < num_classes; ++c) {
+                    if(count[c] > 0)
+                        owner->depot[c].push_back(batch{head[c], count[c]});
+                }
+            }
+        };
+
+        struct thread_caches {
+            std::vector<std::unique_ptr<cache>> all;
+            cache* last = nullptr;  // 绝大多数线程只用一个内存池
+            ~thread_caches() { exited() = true; }
+        };
+
+        std::shared_ptr<core> core_;
+
+    public:
+        explicit SlabResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+            : core_(std::make_shared<core>(upstream)) {}
+
+        SlabResource(const SlabResource&) = delete;
+        SlabResource& operator=(const SlabResource&) = delete;
+        ~SlabResource() override {
+            if(exited())
+                return;
+            thread_caches& tls = caches();
+            tls.last = nullptr;
+            tls.all.erase(std::remove_if(tls.all.begin(), tls.all.end(),
+                                         [this](const std::unique_ptr<cache>& c) { return c->owner == core_; }),
+                          tls.all.end());
+        }
+
+        [[nodiscard]] std::pmr::memory_resource* upstream_resource() const noexcept {
+            return core_->upstream;
+        }
+
+        // 已向上游申请的字节数（不含直接交给上游的大块）
+        [[nodiscard]] std::size_t reserved_bytes() const {
+            std::lock_guard<std::mutex> lock(core_->mtx);
+            std::size_t n = 0;
+            for(auto& c : core_->chunks)
+                n += c.second;
+            return n;
+        }
+
+    protected:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            if(bytes > max_block || alignment > granularity)
+                return core_->upstream->allocate(bytes, alignment);
+            std::size_t c = class_of(bytes);
+            cache* tc = local();
+            if(!tc) {  // 线程局部缓存已经析构（线程退出过程中），借一个临时缓存
+                cache tmp(core_);
+                refill(tmp, c);
+                free_block* b = tmp.head[c];
+                tmp.head[c] = b->next;
+                --tmp.count[c];
+                return b;
+            }
+            if(!tc->head[c])
+                refill(*tc, c);
+            free_block* b = tc->head[c];
+            tc->head[c] = b->next;
+            --tc->count[c];
+            return b;
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            if(bytes > max_block || alignment > granularity) {
+                core_->upstream->deallocate(p, bytes, alignment);
+                return;
+            }
+            std::size_t c = class_of(bytes);
+            auto* b = static_cast<free_block*>(p);
+            cache* tc = local();
+            if(!tc) {
+                b->next = nullptr;
+                std::lock_guard<std::mutex> lock(core_->mtx);
+                core_->depot[c].push_back(batch{b, 1});
+                return;
+            }
+            b->next = tc->head[c];
+            tc->head[c] = b;
+            if(++tc->count[c] > 2 * batch_size)
+                spill(*tc, c);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+    private:
+        static std::size_t class_of(std::size_t bytes) noexcept {
+            return (std::max<std::size_t>(bytes, 1) - 1) / granularity;
+        }
+
+        static thread_caches& caches() {
+            thread_local thread_caches tls;
+            return tls;
+        }
+
+        // 平凡类型的线程局部变量没有析构顺序问题，线程退出后仍可读取
+        static bool& exited() noexcept {
+            thread_local bool flag = false;
+            return flag;
+        }
+
+        // 本线程的缓存；线程退出过程中（缓存已析构）返回 nullptr
+        cache* local() {
+            if(exited())
+                return nullptr;
+            thread_caches& tls = caches();
+            if(tls.last && tls.last->owner == core_)
+                return tls.last;
+            for(auto& c : tls.all) {
+                if(c->owner == core_) {
+                    tls.last = c.get();
+                    return tls.last;
+                }
+            }
+            tls.all.push_back(std::make_unique<cache>(core_));
+            tls.last = tls.all.back().get();
+            return tls.last;
+        }
+
+        // 本地链表为空：从仓库取一批，仓库也为空时向上游申请一个大块并切成 chunk_batches 批
+        void refill(cache& tc, std::size_t c) {
+            std::lock_guard<std::mutex> lock(core_->mtx);
+            auto& depot = core_->depot[c];
+            if(depot.empty()) {
+                const std::size_t block = (c + 1) * granularity;
+                const std::size_t bytes = block * batch_size * chunk_batches;
+                auto* base = static_cast<unsigned char*>(core_->upstream->allocate(bytes, granularity));
+                core_->chunks.emplace_back(base, bytes);
+                for(std::uint32_t k = 0; k < chunk_batches; ++k) {
+                    unsigned char* first = base + k * batch_size * block;
+                    for(std::uint32_t i = 0; i < batch_size; ++i) {
+                        auto* b = reinterpret_cast<free_block*>(first + i * block);
+                        b->next = i + 1 < batch_size ? reinterpret_cast<free_block*>(first + (i + 1) * block) : nullptr;
+                    }
+                    depot.push_back(batch{reinterpret_cast<free_block*>(first), batch_size});
+                }
+            }
+            batch b = depot.back();
+            depot.pop_back();
+            tc.head[c] = b.head;
+            tc.count[c] = b.count;
+        }
+
+        // 本地链表过长：把最近释放的一批交给仓库
+        void spill(cache& tc, std::size_t c) {
+            free_block* first = tc.head[c];
+            free_block* last = first;
+            for(std::uint32_t i = 1; i < batch_size; ++i)
+                last = last->next;
+            tc.head[c] = last->next;
+            tc.count[c] -= batch_size;
+            last->next = nullptr;
+            std::lock_guard<std::mutex> lock(core_->mtx);
+            core_->depot[c].push_back(batch{first, batch_size});
+        }
+    };
+
+    // 分支、future 等默认使用的进程级内存池；故意不析构，分离的工作线程退出时仍可以归还缓存
+    inline SlabResource* default_slab_resource() {
+        static SlabResource* res = new SlabResource();
+        return res;
+    }
+
+}
+
+#endif //SLABRESOURCE_H
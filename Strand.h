@@ -0,0 +1,123 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef STRAND_H
+#define STRAND_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "Task.h"
+#include "WorkBranch.h"
+
+namespace tp {
+
+    // 串行执行器：投递到同一个 strand 的任务严格按先进先出的顺序执行，任意时刻最多执行一个，
+    // 但不固定在某个线程上，由分支中空闲的线程执行。适合按消息逐步推进的 actor 式状态。
+    // 投递是无锁的：任务进入多生产者单消费者链表，计数从 0 变为 1 的投递者负责向分支提交一个排空任务；
+    // 排空任务每轮最多执行 max_batch 个任务，还有剩余时重新提交自己，让出线程给分支上的其他任务
+    class strand {
+        struct node {
+            std::atomic<node*> next{nullptr};
+            Task task;
+        };
+
+        WorkBranch& br_;
+        std::pmr::memory_resource* mr_;
+        const std::size_t max_batch_;
+        alignas(64) std::atomic<node*> tail_;     // 生产者交换
+        alignas(64) std::atomic<std::size_t> pending_{0};  // 已投递、尚未执行完的任务数
+        alignas(64) node* head_;  // 哑节点，它的 next 是下一个要执行的任务；只由排空任务访问
+
+    public:
+        explicit strand(WorkBranch& br, std::size_t max_batch = 32)
+            : br_(br)
+            , mr_(br.memory_resource())
+            , max_batch_(max_batch) {
+            if(max_batch_ == 0)
+                throw std::invalid_argument("workspace: strand max_batch must be positive");
+            head_ = make_node(Task());
+            tail_.store(head_, std::memory_order_relaxed);
+        }
+
+        strand(const strand&) = delete;
+        strand& operator=(const strand&) = delete;
+        // 等待已投递的任务全部执行完；在本分支的工作线程上析构时帮忙执行，不会等待自己
+        ~strand() {
+            while(pending_.load(std::memory_order_acquire) != 0) {
+                if(!br_.run_pending_task())
+                    std::this_thread::yield();
+            }
+            free_node(head_);
+        }
+
+        // 投递一个任务，在之前投递的任务都执行完之后执行；任务抛出的异常与分支上的任务一样处理，不影响后续任务
+        template <typename F>
+        void post(F&& task) {
+            node* n = make_node(Task(std::forward<F>(task)));
+            node* prev = tail_.exchange(n, std::memory_order_acq_rel);
+            prev->next.store(n, std::memory_order_release);
+            if(pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+                schedule();
+        }
+
+        [[nodiscard]] std::size_t num_pending() const {
+            return pending_.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] WorkBranch& branch() const noexcept {
+            return br_;
+        }
+
+    private:
+        // 排空任务经 dispatch 超额占位且不可丢弃：被拒绝或丢弃的话 strand 会停住，析构时永远等下去
+        void schedule() {
+            br_.dispatch([this] { drain(); });
+        }
+
+        // 同一时刻只有一个排空任务：只有它能把计数减到 0，在此之前投递者看到的计数都不为 0。
+        // 最多执行开始时计数的那么多个任务，计数因此不会减成负数
+        void drain() {
+            std::size_t budget = std::min(pending_.load(std::memory_order_acquire), max_batch_);
+            std::size_t done = 0;
+            Task task;
+            while(done < budget && pop(task)) {
+                WorkBranch::invoke_guarded(task);
+                task.reset();
+                ++done;
+            }
+            // 之后不能再访问成员（计数归零后 strand 可能已被析构），除非还有剩余任务
+            if(pending_.fetch_sub(done, std::memory_order_acq_rel) != done)
+                schedule();
+        }
+
+        // 生产者已交换 tail_ 但尚未链接时返回 false，剩余的任务留给下一轮
+        bool pop(Task& task) {
+            node* next = head_->next.load(std::memory_order_acquire);
+            if(!next)
+                return false;
+            task = std::move(next->task);
+            free_node(head_);
+            head_ = next;
+            return true;
+        }
+
+        node* make_node(Task&& task) {
+            return ::new(mr_->allocate(sizeof(node), alignof(node))) node{{nullptr}, std::move(task)};
+        }
+
+        void free_node(node* n) {
+            n->~node();
+            mr_->deallocate(n, sizeof(node), alignof(node));
+        }
+    };
+
+}
+
+#endif //STRAND_H
@@ -5,15 +5,38 @@
 #ifndef SUPERVISOR_H
 #define SUPERVISOR_H
 
+#include <chrono>
 #include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <utility>
 
 #include "AutoThread.h"
+#include "ScalingPolicy.h"
+#include "Trace.h"
 #include "WorkBranch.h"
 
 namespace tp {
     class Supervisor {
         using tick_callback_t = std::function<void()>;
+        using policy_factory_t = std::function<std::unique_ptr<ScalingPolicy>()>;
+        using clock = std::chrono::steady_clock;
+
+        // 每个被监管分支的上一次采样和滑动平均
+        struct branch_state {
+            WorkBranch* br = nullptr;
+            std::unique_ptr<ScalingPolicy> policy;
+            clock::time_point last{};
+            std::uint64_t executed = 0;
+            std::uint64_t busy_ns = 0;
+            std::uint64_t alive_ns = 0;   // busy + idle + parked
+            std::size_t in_flight = 0;
+            scaling_sample avg;
+            bool primed = false;
+        };
+        static constexpr double ewma_alpha = 0.3;
+
     private:
         bool stop_ = false;
 
@@ -23,18 +46,20 @@ namespace tp {
         const unsigned tval_ = 0;
 
         tick_callback_t tick_cb_ = {};
-        AutoThread<join> worker_;
-        std::vector<WorkBranch*> branches_;
+        policy_factory_t policy_factory_ = [] { return std::make_unique<HysteresisPolicy>(); };
+        std::vector<branch_state> branches_;
         std::condition_variable thrd_cv_;
         std::mutex spv_lok_;
+        AutoThread<join> worker_{std::thread()};  // 最后构造、最先析构，线程运行时其他成员都已就绪
     public:
         Supervisor(int min_wokrs, int max_wokrs, unsigned time_interval = 500)
             : wmin_(min_wokrs)
             , wmax_(max_wokrs)
             , timeout_(time_interval)
-            , tval_(time_interval)
-            , worker_(std::thread(&Supervisor::mission, this)) {
-            static_assert(min_wokrs >= 0 && max_wokrs > 0 && max_wokrs > min_wokrs);
+            , tval_(time_interval) {
+            if(!(min_wokrs >= 0 && max_wokrs > 0 && max_wokrs > min_wokrs))
+                throw std::invalid_argument("workspace: Supervisor requires 0 <= min_wokrs < max_wokrs");
+            worker_ = AutoThread<join>(std::thread(&Supervisor::mission, this));
         }
 
         Supervisor(const Supervisor&) = delete;
@@ -48,7 +73,24 @@ namespace tp {
     public:
         void supervise(WorkBranch& wbr) {
             std::lock_guard<std::mutex> lock(spv_lok_);
-            branches_.emplace_back(&wbr);
+            branch_state st;
+            st.br = &wbr;
+            st.policy = policy_factory_();
+            branches_.emplace_back(std::move(st));
+        }
+
+        // 替换扩缩容策略，每个分支（包括已经在监管的分支）得到一个新的策略实例
+        void set_policy(policy_factory_t factory) {
+            if(!factory)
+                throw std::invalid_argument("workspace: Supervisor policy factory is empty");
+            std::lock_guard<std::mutex> lock(spv_lok_);
+            policy_factory_ = std::move(factory);
+            for(auto& st : branches_)
+                st.policy = policy_factory_();
+        }
+
+        void set_policy(const hysteresis_options& opts) {
+            set_policy([opts] { return std::make_unique<HysteresisPolicy>(opts); });
         }
 
         void proceed() {
@@ -65,32 +107,97 @@ namespace tp {
 
     private:
         void mission() {
+            TP_TRACE_THREAD_NAME("Supervisor");
             while(!stop_) {
                 try {
                     {
                         std::unique_lock<std::mutex> lock(spv_lok_);
-                        for(auto pbr: branches_) {
-                            auto tknums = pbr->num_tasks();
-                            auto wknums = pbr->num_workers();
-                            if(tknums) {
-                                static_assert(wknums <= wmax_);
-                                std::size_t nums = std::min(wmax_-wknums, tknums-wknums);
-                                for(std::size_t i = 0; i<nums; i++)
-                                    pbr->add_worker();
-                            }
-                            else if (wknums > wmin_)
-                                pbr->del_worker();
-                        }
+                        for(auto& st: branches_)
+                            rescale(st);
                         if(!stop_)
                             thrd_cv_.wait_for(lock, std::chrono::milliseconds(timeout_));
                     }
-                    tick_cb_();
+                    if(tick_cb_)
+                        tick_cb_();
                 } catch (const std::exception& ex) {
                     std::cerr<<"workspace: supervisor["<< std::this_thread::get_id()<<"] caught exception:\n  \
                 what(): "<<ex.what()<<'\n'<<std::flush;
                 }
             }
         }
+
+        // 采样一个分支，交给策略决定线程数的变化并执行
+        void rescale(branch_state& st) {
+            scaling_sample s = sample(st);
+            if(!st.primed) {  // 第一次只建立基准
+                st.primed = true;
+                return;
+            }
+            long delta = st.policy->decide(s);
+            if(delta > 0) {
+                std::size_t n = std::min<std::size_t>(static_cast<std::size_t>(delta), wmax_ > s.workers ? wmax_ - s.workers : 0);
+                for(std::size_t i = 0; i < n; ++i) {
+                    st.br->add_worker();
+                    TP_TRACE(trace::event::worker_added, reinterpret_cast<std::uintptr_t>(st.br));
+                }
+            }
+            else if(delta < 0) {
+                std::size_t n = std::min<std::size_t>(static_cast<std::size_t>(-delta), s.workers > wmin_ ? s.workers - wmin_ : 0);
+                for(std::size_t i = 0; i < n; ++i) {
+                    st.br->del_worker();
+                    TP_TRACE(trace::event::worker_removed, reinterpret_cast<std::uintptr_t>(st.br));
+                }
+            }
+        }
+
+        // 由两次 metrics() 快照之差得到到达率、执行时间和空闲比例；不开启 collect_timing 时用在途任务数估算
+        scaling_sample sample(branch_state& st) {
+            branch_metrics m = st.br->metrics();
+            clock::time_point now = clock::now();
+            scaling_sample s;
+            s.now = now;
+            s.interval = st.primed ? now - st.last : clock::duration{};
+            s.workers = st.br->num_workers();
+            s.min_workers = wmin_;
+            s.max_workers = wmax_;
+            s.queued = st.br->num_tasks();
+
+            std::uint64_t alive = m.total.busy_ns + m.total.idle_ns + m.total.parked_ns;
+            double dt = std::chrono::duration<double>(s.interval).count();
+            double executed = static_cast<double>(m.total.tasks_executed - st.executed);
+            double busy = static_cast<double>(m.total.busy_ns - st.busy_ns);
+            double span = static_cast<double>(alive - st.alive_ns);
+            double workers = static_cast<double>(std::max<std::size_t>(s.workers, 1));
+            double in_flight = static_cast<double>(m.in_flight);
+
+            if(dt > 0) {
+                double completion = executed / dt;
+                double arrival = std::max(0.0, executed + in_flight - static_cast<double>(st.in_flight)) / dt;
+                double service = 0;
+                if(executed > 0)
+                    service = busy > 0 ? busy / executed : std::min(workers, in_flight) * dt * 1e9 / executed;
+                double idle = span > 0 ? 1.0 - std::min(1.0, busy / span) : 1.0 - std::min(workers, in_flight) / workers;
+                auto ewma = [](double prev, double cur) { return prev + ewma_alpha * (cur - prev); };
+                st.avg.arrival_rate = ewma(st.avg.arrival_rate, arrival);
+                st.avg.completion_rate = ewma(st.avg.completion_rate, completion);
+                if(service > 0)
+                    st.avg.service_time_ns = st.avg.service_time_ns > 0 ? ewma(st.avg.service_time_ns, service) : service;
+                st.avg.idle_ratio = ewma(st.avg.idle_ratio, idle);
+                st.avg.queued_avg = ewma(st.avg.queued_avg, static_cast<double>(s.queued));
+            }
+            s.queued_avg = st.avg.queued_avg;
+            s.arrival_rate = st.avg.arrival_rate;
+            s.completion_rate = st.avg.completion_rate;
+            s.service_time_ns = st.avg.service_time_ns;
+            s.idle_ratio = st.avg.idle_ratio;
+
+            st.last = now;
+            st.executed = m.total.tasks_executed;
+            st.busy_ns = m.total.busy_ns;
+            st.alive_ns = alive;
+            st.in_flight = m.in_flight;
+            return s;
+        }
     };
 }
 
@@ -0,0 +1,168 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "SlabResource.h"
+
+#ifndef TP_TASK_INLINE_SIZE
+#define TP_TASK_INLINE_SIZE 64
+#endif
+
+namespace tp {
+
+    // 只能移动的 void() 可调用对象包装，代替 std::function<void()>
+    // 不超过 InlineSize 字节且移动不抛异常的可调用对象直接存放在对象内部，不分配堆内存；
+    // 放不下的从构造时指定的 memory_resource 分配（默认 default_slab_resource()），资源指针和对象指针一起保存在内部；
+    // 可以保存 lambda 捕获的 std::promise、std::unique_ptr 等只能移动的对象
+    template <std::size_t InlineSize>
+    class InlineTask {
+        struct ops_t {
+            void (*invoke)(void*);
+            void (*move)(void* dst, void* src) noexcept;  // 移动构造到 dst 并析构 src
+            void (*destroy)(void*) noexcept;
+        };
+
+        template <typename F>
+        static constexpr bool fits_inline =
+            sizeof(F) <= InlineSize &&
+            alignof(F) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible_v<F>;
+
+        template <typename F>
+        struct inline_ops {
+            static F* self(void* p) noexcept { return std::launder(reinterpret_cast<F*>(p)); }
+            static void invoke(void* p) { (*self(p))(); }
+            static void move(void* dst, void* src) noexcept {
+                ::new(dst) F(std::move(*self(src)));
+                self(src)->~F();
+            }
+            static void destroy(void* p) noexcept { self(p)->~F(); }
+            static constexpr ops_t table{&invoke, &move, &destroy};
+        };
+
+        template <typename F>
+        struct heap_slot {
+            F* obj;
+            std::pmr::memory_resource* mr;  // 释放时归还给分配它的资源
+        };
+
+        template <typename F>
+        struct heap_ops {
+            static heap_slot<F>& slot(void* p) noexcept { return *std::launder(reinterpret_cast<heap_slot<F>*>(p)); }
+            static void invoke(void* p) { (*slot(p).obj)(); }
+            static void move(void* dst, void* src) noexcept {
+                ::new(dst) heap_slot<F>(slot(src));
+            }
+            static void destroy(void* p) noexcept {
+                heap_slot<F>& s = slot(p);
+                s.obj->~F();
+                s.mr->deallocate(s.obj, sizeof(F), alignof(F));
+            }
+            static constexpr ops_t table{&invoke, &move, &destroy};
+        };
+
+        static_assert(InlineSize >= sizeof(heap_slot<InlineTask*>), "InlineTask needs room for a pointer and a memory_resource*");
+
+        alignas(std::max_align_t) unsigned char storage_[InlineSize];
+        const ops_t* ops_ = nullptr;
+        bool pinned_ = false;  // 占用对齐填充，不增大对象
+
+    public:
+        static constexpr std::size_t inline_size = InlineSize;
+
+        InlineTask() noexcept = default;
+        InlineTask(std::nullptr_t) noexcept {}
+
+        template <
+            typename F,
+            typename D = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same_v<D, InlineTask> && std::is_invocable_v<D&>>
+        >
+        InlineTask(F&& f)  // NOLINT: 与 std::function 一样允许隐式转换
+            : InlineTask(std::allocator_arg, nullptr, std::forward<F>(f)) {}
+
+        // 放不下时从 mr 分配，mr 为空时使用 default_slab_resource()
+        template <
+            typename F,
+            typename D = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same_v<D, InlineTask> && std::is_invocable_v<D&>>
+        >
+        InlineTask(std::allocator_arg_t, std::pmr::memory_resource* mr, F&& f) {
+            if constexpr (fits_inline<D>) {
+                ::new(static_cast<void*>(storage_)) D(std::forward<F>(f));
+                ops_ = &inline_ops<D>::table;
+            } else {
+                if(!mr)
+                    mr = default_slab_resource();
+                void* mem = mr->allocate(sizeof(D), alignof(D));
+                try {
+                    ::new(static_cast<void*>(storage_)) heap_slot<D>{::new(mem) D(std::forward<F>(f)), mr};
+                } catch (...) {
+                    mr->deallocate(mem, sizeof(D), alignof(D));
+                    throw;
+                }
+                ops_ = &heap_ops<D>::table;
+            }
+        }
+
+        InlineTask(InlineTask&& other) noexcept : ops_(other.ops_), pinned_(other.pinned_) {
+            if(ops_) {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+
+        InlineTask& operator=(InlineTask&& other) noexcept {
+            if(this != &other) {
+                reset();
+                if(other.ops_) {
+                    other.ops_->move(storage_, other.storage_);
+                    ops_ = other.ops_;
+                    other.ops_ = nullptr;
+                }
+                pinned_ = other.pinned_;
+            }
+            return *this;
+        }
+
+        InlineTask(const InlineTask&) = delete;
+        InlineTask& operator=(const InlineTask&) = delete;
+
+        ~InlineTask() { reset(); }
+
+        void operator()() { ops_->invoke(storage_); }
+
+        explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+        void reset() noexcept {
+            if(ops_) {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+            pinned_ = false;
+        }
+
+        // 标记为不可丢弃：WorkBranch 的 drop_oldest 溢出策略会跳过它
+        void pin() noexcept { pinned_ = true; }
+        [[nodiscard]] bool pinned() const noexcept { return pinned_; }
+
+        // 可调用对象是否保存在对象内部（用于测试/基准）
+        template <typename F>
+        static constexpr bool is_inline() noexcept { return fits_inline<std::decay_t<F>>; }
+    };
+
+    using Task = InlineTask<TP_TASK_INLINE_SIZE>;
+
+}
+
+#endif //TASK_H
@@ -0,0 +1,220 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "WorkBranch.h"
+
+namespace tp {
+
+    // 运行期构建的任务图：节点之间用 precede/succeed 连边，依赖全部完成的节点立即提交到分支执行。
+    // 依赖关系用原子计数器维护，不使用 future；图构建一次后可以反复 run，不再分配内存。
+    // 运行期间（run 到 wait 返回之前）不能修改图。
+    class TaskGraph {
+    public:
+        class Node {
+            friend class TaskGraph;
+
+            std::function<void()> work_;
+            std::vector<Node*> successors_;
+            std::size_t num_deps_ = 0;
+            std::atomic<std::size_t> join_{0};  // 本轮运行中尚未完成的前驱数
+            TaskGraph* graph_ = nullptr;
+            std::size_t index_ = 0;  // 在 nodes_ 中的下标
+
+        public:
+            Node(TaskGraph* graph, std::size_t index, std::function<void()> work)
+                : work_(std::move(work)), graph_(graph), index_(index) {}
+            Node(const Node&) = delete;
+            Node& operator=(const Node&) = delete;
+
+            // this 完成后才能运行 others
+            template <typename ...Nodes>
+            Node& precede(Node& other, Nodes& ...others) {
+                link(*this, other);
+                (link(*this, others), ...);
+                return *this;
+            }
+
+            // others 完成后才能运行 this
+            template <typename ...Nodes>
+            Node& succeed(Node& other, Nodes& ...others) {
+                link(other, *this);
+                (link(others, *this), ...);
+                return *this;
+            }
+
+            [[nodiscard]] std::size_t num_successors() const { return successors_.size(); }
+            [[nodiscard]] std::size_t num_dependents() const { return num_deps_; }
+
+        private:
+            static void link(Node& from, Node& to) {
+                if(from.graph_ != to.graph_)
+                    throw std::invalid_argument("workspace: Cannot link nodes of different task graphs");
+                from.successors_.push_back(&to);
+                ++to.num_deps_;
+                from.graph_->checked_ = false;
+            }
+        };
+
+    private:
+        std::vector<std::unique_ptr<Node>> nodes_;
+        std::vector<Node*> roots_;
+        bool checked_ = true;   // 拓扑结构是否已检查过（无环）并计算过根节点
+
+        WorkBranch* br_ = nullptr;
+        std::atomic<std::size_t> pending_{0};  // 本轮运行中尚未完成的节点数
+        std::atomic<bool> failed_{false};
+        std::exception_ptr error_;
+
+        std::mutex mtx_;
+        std::condition_variable done_cv_;
+        bool running_ = false;
+
+    public:
+        TaskGraph() = default;
+        TaskGraph(const TaskGraph&) = delete;
+        TaskGraph& operator=(const TaskGraph&) = delete;
+        ~TaskGraph() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            done_cv_.wait(lock, [this] { return !running_; });
+        }
+
+        template <typename F>
+        Node& emplace(F&& work) {
+            nodes_.emplace_back(std::make_unique<Node>(this, nodes_.size(), std::function<void()>(std::forward<F>(work))));
+            checked_ = false;
+            return *nodes_.back();
+        }
+
+        [[nodiscard]] std::size_t size() const { return nodes_.size(); }
+        [[nodiscard]] bool empty() const { return nodes_.empty(); }
+
+        // 把没有前驱的节点提交到 br，立即返回；用 wait() 等待本轮完成
+        void run(WorkBranch& br) {
+            check();
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(running_)
+                    throw std::runtime_error("workspace: Task graph is already running");
+                if(nodes_.empty())
+                    return;
+                running_ = true;
+            }
+            br_ = &br;
+            error_ = nullptr;
+            failed_.store(false, std::memory_order_relaxed);
+            for(auto& node : nodes_)
+                node->join_.store(node->num_deps_, std::memory_order_relaxed);
+            pending_.store(nodes_.size(), std::memory_order_release);
+            for(Node* root : roots_)
+                schedule(root);
+        }
+
+        // 等待本轮运行结束，等待期间帮分支执行排队中的任务；重新抛出节点中的第一个异常
+        void wait() {
+            if(br_)  // 从未运行过时没有分支可以帮忙
+                br_->help_until([this] { return pending_.load(std::memory_order_acquire) == 0; });
+            std::unique_lock<std::mutex> lock(mtx_);
+            done_cv_.wait(lock, [this] { return !running_; });  // 最后一个节点计数归零后才在锁内复位 running_
+            if(error_)
+                std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+
+        void run_and_wait(WorkBranch& br) {
+            run(br);
+            wait();
+        }
+
+    private:
+        // 拓扑排序检查有没有环，并记录根节点；只在图被修改后的第一次运行时执行
+        void check() {
+            if(checked_)
+                return;
+            roots_.clear();
+            std::vector<std::size_t> deps;
+            std::vector<Node*> ready;
+            deps.reserve(nodes_.size());
+            for(auto& node : nodes_) {
+                deps.push_back(node->num_deps_);
+                if(node->num_deps_ == 0) {
+                    roots_.push_back(node.get());
+                    ready.push_back(node.get());
+                }
+            }
+            std::size_t visited = 0;
+            while(!ready.empty()) {
+                Node* node = ready.back();
+                ready.pop_back();
+                ++visited;
+                for(Node* succ : node->successors_)
+                    if(--deps[succ->index_] == 0)
+                        ready.push_back(succ);
+            }
+            if(visited != nodes_.size())
+                throw std::invalid_argument("workspace: Task graph contains a cycle");
+            checked_ = true;
+        }
+
+        // 提交失败（例如内存不足）时本轮以这个异常结束：节点改在当前线程上执行，跳过工作但照常释放后继，
+        // 计数才能归零，wait 和析构不会永远等待
+        void schedule(Node* node) {
+            try {
+                br_->dispatch([node] { node->graph_->execute(node); });
+            } catch (...) {
+                if(!failed_.exchange(true))
+                    error_ = std::current_exception();
+                execute(node);
+            }
+        }
+
+        // 执行节点并释放后继；第一个就绪的后继直接在当前线程继续执行，省去一次调度
+        void execute(Node* node) {
+            while(node) {
+                if(!failed_.load(std::memory_order_relaxed)) {
+                    try {
+                        node->work_();
+                    } catch (...) {
+                        if(!failed_.exchange(true))  // 只保留第一个异常，其余节点跳过执行
+                            error_ = std::current_exception();
+                    }
+                }
+                Node* next = nullptr;
+                for(Node* succ : node->successors_) {
+                    if(succ->join_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        if(next)
+                            schedule(succ);
+                        else
+                            next = succ;
+                    }
+                }
+                finish_one();
+                node = next;
+            }
+        }
+
+        void finish_one() {
+            if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                running_ = false;
+                done_cv_.notify_all();
+                br_->wake_helpers();  // wait() 中休眠的线程
+            }
+        }
+    };
+
+}
+
+#endif //TASKGRAPH_H
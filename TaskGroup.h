@@ -0,0 +1,118 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TASKGROUP_H
+#define TASKGROUP_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "WorkBranch.h"
+
+namespace tp {
+
+    // 一组提交到同一分支的任务，可以只等待这一组完成，而不必等待整个分支空闲。
+    // 计数只在可能归零（或从零开始）时才加锁，保证 wait 返回后不再有任务访问本对象。
+    // 组内任务经 WorkBranch::dispatch 提交，不受 branch_options::capacity 的溢出策略影响。
+    class TaskGroup {
+        WorkBranch& br_;
+        std::atomic<std::size_t> pending_{0};
+        std::atomic<bool> failed_{false};
+        std::exception_ptr error_;
+
+        std::mutex mtx_;
+        std::condition_variable done_cv_;
+
+    public:
+        explicit TaskGroup(WorkBranch& br) noexcept : br_(br) {}
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        ~TaskGroup() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            done_cv_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+        }
+
+        template <
+            typename T = normal,
+            typename F,
+            typename = std::enable_if_t<is_queue_tag_v<T>>
+        >
+        void submit(F&& task) {
+            add_one();
+            try {
+                br_.dispatch<T>([this, task = std::forward<F>(task)]() mutable {
+                    try {
+                        task();
+                    } catch (...) {
+                        if(!failed_.exchange(true))  // 只保留第一个异常
+                            error_ = std::current_exception();
+                    }
+                    finish_one();
+                });
+            } catch (...) {  // 没有提交出去（例如优先级超出分支的级数），撤销计数，否则 wait 和析构永远等待
+                finish_one();
+                throw;
+            }
+        }
+
+        [[nodiscard]] std::size_t num_pending() const {
+            return pending_.load(std::memory_order_acquire);
+        }
+
+        // 等待本组任务全部完成，等待期间帮分支执行排队中的任务；重新抛出组内的第一个异常
+        void wait() {
+            br_.help_until([this] { return idle(); });
+            std::lock_guard<std::mutex> lock(mtx_);  // 最后一个任务在锁内归零，等它离开临界区
+            rethrow();
+        }
+
+        // 最多等待 timeout，超时返回 false；完成时重新抛出组内的第一个异常
+        // 不帮忙执行任务，否则一个耗时的任务就会让等待超过期限
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if(!done_cv_.wait_for(lock, timeout, [this] { return idle(); }))
+                return false;
+            rethrow();
+            return true;
+        }
+
+    private:
+        bool idle() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+        void add_one() {
+            std::size_t n = pending_.load(std::memory_order_relaxed);
+            while(n > 0 && !pending_.compare_exchange_weak(n, n + 1, std::memory_order_relaxed)) {}
+            if(n == 0) {  // 从零开始，与 finish_one 的归零互斥
+                std::lock_guard<std::mutex> lock(mtx_);
+                pending_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void finish_one() {
+            std::size_t n = pending_.load(std::memory_order_relaxed);
+            while(n > 1 && !pending_.compare_exchange_weak(n, n - 1, std::memory_order_acq_rel)) {}
+            if(n == 1) {  // 可能是最后一个，加锁后再归零并通知
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    done_cv_.notify_all();
+                    br_.wake_helpers();  // wait() 中休眠的线程
+                }
+            }
+        }
+
+        void rethrow() {
+            if(failed_.exchange(false, std::memory_order_acquire))
+                std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    };
+
+}
+
+#endif //TASKGROUP_H
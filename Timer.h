@@ -0,0 +1,306 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AutoThread.h"
+#include "Trace.h"
+#include "WorkBranch.h"
+
+namespace tp {
+
+    namespace detail {
+        using timer_clock = std::chrono::steady_clock;
+
+        // 一个定时任务，最小堆、句柄和已提交到分支的任务共享同一个节点
+        struct timer_node {
+            enum : int { pending, fired, cancelled };
+            std::atomic<int> status{pending};
+            timer_clock::time_point deadline{};
+            timer_clock::duration period{};  // 为 0 时只执行一次
+            bool queued = false;   // 在堆中，由 timer_core 的锁保护
+            bool counted = false;  // 已计入 timer_core::cancelled_，由 timer_core 的锁保护
+
+            virtual ~timer_node() = default;
+            // 提交到分支时的异常（例如优先级超出分支的级数）由节点自己报告给分支，这里不抛出
+            virtual void fire(std::shared_ptr<timer_node> self) noexcept = 0;
+        };
+
+        // 计时线程与定时任务共享的状态；周期任务执行完后回到这里重新排队，Timer 析构后不再接受
+        class timer_core {
+            struct entry {
+                timer_clock::time_point when;
+                std::uint64_t seq;  // 同一时刻到期的任务按提交顺序触发
+                std::shared_ptr<timer_node> node;
+                bool operator>(const entry& o) const { return when != o.when ? when > o.when : seq > o.seq; }
+            };
+            static constexpr std::size_t compact_threshold = 1024;
+
+            std::mutex mtx_;
+            std::condition_variable cv_;
+            std::vector<entry> heap_;  // 按 std::greater 维护的最小堆，由 mtx_ 保护
+            std::uint64_t seq_ = 0;
+            bool stop_ = false;
+            std::size_t cancelled_ = 0;  // 已取消但仍在堆中的节点数，由 mtx_ 保护
+
+        public:
+            void schedule(std::shared_ptr<timer_node> node) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(stop_)
+                    return;
+                bool earliest = heap_.empty() || node->deadline < heap_.front().when;
+                node->queued = true;
+                heap_.push_back(entry{node->deadline, seq_++, std::move(node)});
+                std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+                if(earliest)  // 只有新的最早到期时间才需要叫醒计时线程
+                    cv_.notify_one();
+            }
+
+            void note_cancelled(timer_node& node) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(node.queued && !node.counted) {
+                    node.counted = true;
+                    ++cancelled_;
+                }
+            }
+
+            [[nodiscard]] std::size_t size() {
+                std::lock_guard<std::mutex> lock(mtx_);
+                return heap_.size() - cancelled_;
+            }
+
+            void stop() {
+                std::lock_guard<std::mutex> lock(mtx_);
+                stop_ = true;
+                heap_.clear();
+                cancelled_ = 0;
+                cv_.notify_one();
+            }
+
+            void run() {
+                TP_TRACE_THREAD_NAME("Timer");
+                std::vector<std::shared_ptr<timer_node>> due;
+                std::unique_lock<std::mutex> lock(mtx_);
+                while(!stop_) {
+                    if(heap_.empty()) {
+                        cv_.wait(lock);
+                        continue;
+                    }
+                    compact();
+                    auto now = timer_clock::now();
+                    while(!heap_.empty() && heap_.front().when <= now) {
+                        std::pop_heap(heap_.begin(), heap_.end(), std::greater<>{});
+                        due.push_back(unqueue(heap_.back()));
+                        heap_.pop_back();
+                    }
+                    if(due.empty()) {
+                        if(!heap_.empty()) {
+                            auto next = heap_.front().when;  // 等待期间堆可能重新分配，不能传引用
+                            cv_.wait_until(lock, next);
+                        }
+                        continue;
+                    }
+                    lock.unlock();  // 提交到分支时不持有锁，到期的任务可能很多
+                    for(auto& node : due) {
+                        if(node->status.load(std::memory_order_acquire) == timer_node::cancelled)
+                            continue;
+                        node->fire(std::move(node));
+                    }
+                    due.clear();
+                    lock.lock();
+                }
+            }
+
+        private:
+            // 大量定时任务被取消时重建堆，避免已取消的节点长期占用内存；调用者持有 mtx_
+            void compact() {
+                if(cancelled_ < compact_threshold || cancelled_ * 2 < heap_.size())
+                    return;
+                auto live = std::partition(heap_.begin(), heap_.end(), [](const entry& e) {
+                    return e.node->status.load(std::memory_order_acquire) != timer_node::cancelled;
+                });
+                for(auto it = live; it != heap_.end(); ++it)
+                    unqueue(*it);
+                heap_.erase(live, heap_.end());
+                std::make_heap(heap_.begin(), heap_.end(), std::greater<>{});
+            }
+
+            // 节点离开堆；调用者持有 mtx_
+            std::shared_ptr<timer_node> unqueue(entry& e) {
+                e.node->queued = false;
+                if(e.node->counted) {
+                    e.node->counted = false;
+                    --cancelled_;
+                }
+                return std::move(e.node);
+            }
+        };
+
+        template <typename T, typename F>
+        struct timer_task final : timer_node {
+            WorkBranch* br;
+            std::weak_ptr<timer_core> core;
+            F fn;
+
+            timer_task(WorkBranch* b, std::weak_ptr<timer_core> c, F&& f)
+                : br(b), core(std::move(c)), fn(std::move(f)) {}
+
+            void fire(std::shared_ptr<timer_node> self) noexcept override {
+                WorkBranch* b = br;  // 提交失败时 self 已随任务销毁，不能再访问成员
+                try {
+                    submit(std::move(self));
+                } catch (...) {  // 丢弃这个任务，异常交给分支的错误队列或 error_handler
+                    b->report_error(std::current_exception());
+                }
+            }
+
+            // 经 dispatch 提交：计时线程不会因分支已满而等待（其余定时任务都排在它后面），
+            // caller_runs 也不会把任务放到计时线程上执行，周期任务的下一次也不会被 drop_oldest 丢掉
+            void submit(std::shared_ptr<timer_node> self) {
+                if(period == timer_clock::duration::zero()) {
+                    int expected = pending;
+                    if(status.compare_exchange_strong(expected, fired, std::memory_order_acq_rel))
+                        br->dispatch<T>([self = std::move(self)] { static_cast<timer_task&>(*self).fn(); });
+                    return;
+                }
+                // 周期任务执行完才排下一次，慢任务不会与自己重叠；错过的周期直接跳过，不会集中补执行
+                br->dispatch<T>([self = std::move(self)]() mutable {
+                    auto& t = static_cast<timer_task&>(*self);
+                    if(t.status.load(std::memory_order_acquire) == cancelled)
+                        return;
+                    struct rearm {
+                        std::shared_ptr<timer_node>& node;
+                        ~rearm() {
+                            auto& t = static_cast<timer_task&>(*node);
+                            auto c = t.core.lock();
+                            if(!c || t.status.load(std::memory_order_acquire) == cancelled)
+                                return;
+                            t.deadline = std::max(t.deadline + t.period, timer_clock::now());
+                            c->schedule(std::move(node));
+                        }
+                    } guard{self};
+                    t.fn();
+                });
+            }
+        };
+    }
+
+    // 定时任务的句柄，只用于取消；不持有任务，任务执行完或 Timer 析构后句柄自动失效
+    class timer_handle {
+        std::weak_ptr<detail::timer_node> node_;
+        std::weak_ptr<detail::timer_core> core_;
+    public:
+        timer_handle() = default;
+        timer_handle(std::weak_ptr<detail::timer_node> node, std::weak_ptr<detail::timer_core> core)
+            : node_(std::move(node)), core_(std::move(core)) {}
+
+        // 阻止尚未开始的执行；周期任务不再排下一次，正在执行的那一次不受影响。
+        // 返回 true 表示本次调用取消了任务
+        bool cancel() {
+            auto node = node_.lock();
+            if(!node)
+                return false;
+            int expected = detail::timer_node::pending;
+            if(!node->status.compare_exchange_strong(expected, detail::timer_node::cancelled, std::memory_order_acq_rel))
+                return false;
+            if(auto core = core_.lock())
+                core->note_cancelled(*node);
+            return true;
+        }
+
+        // 任务仍在等待到期（周期任务在取消之前始终如此）
+        [[nodiscard]] bool pending() const {
+            auto node = node_.lock();
+            return node && node->status.load(std::memory_order_acquire) == detail::timer_node::pending;
+        }
+    };
+
+    // 一个计时线程维护按到期时间排序的最小堆，到期的任务提交到 br 执行，等待期间不占用分支的工作线程。
+    // 插入和取消都是 O(log n) 以内，几十万个定时任务也只有这一个线程。Timer 必须先于 br 析构
+    class Timer {
+        WorkBranch& br_;
+        std::shared_ptr<detail::timer_core> core_;
+        AutoThread<join> worker_{std::thread()};  // 最后构造、最先析构
+
+    public:
+        explicit Timer(WorkBranch& br)
+            : br_(br)
+            , core_(std::make_shared<detail::timer_core>()) {
+            worker_ = AutoThread<join>(std::thread(&detail::timer_core::run, core_));
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+        // 尚未到期的任务全部丢弃，已经提交到分支的任务照常执行
+        ~Timer() {
+            core_->stop();
+        }
+
+        // 在 when 或之后执行 fn；其他时钟的时间点按与当前时刻的差值换算
+        template <typename T = normal, typename F, typename Clock, typename Duration,
+                  typename = std::enable_if_t<is_queue_tag_v<T>>>
+        timer_handle submit_at(const std::chrono::time_point<Clock, Duration>& when, F&& fn) {
+            return add<T>(to_steady(when), detail::timer_clock::duration::zero(), std::forward<F>(fn));
+        }
+
+        template <typename T = normal, typename F, typename Rep, typename Period,
+                  typename = std::enable_if_t<is_queue_tag_v<T>>>
+        timer_handle submit_after(const std::chrono::duration<Rep, Period>& delay, F&& fn) {
+            return add<T>(detail::timer_clock::now() + std::chrono::duration_cast<detail::timer_clock::duration>(delay),
+                          detail::timer_clock::duration::zero(), std::forward<F>(fn));
+        }
+
+        // 每隔 period 执行一次，第一次在一个周期之后；直到句柄 cancel() 或 Timer 析构
+        template <typename T = normal, typename F, typename Rep, typename Period,
+                  typename = std::enable_if_t<is_queue_tag_v<T>>>
+        timer_handle submit_every(const std::chrono::duration<Rep, Period>& period, F&& fn) {
+            auto p = std::chrono::duration_cast<detail::timer_clock::duration>(period);
+            if(p <= detail::timer_clock::duration::zero())
+                throw std::invalid_argument("workspace: Timer period must be positive");
+            return add<T>(detail::timer_clock::now() + p, p, std::forward<F>(fn));
+        }
+
+        // 等待到期的任务数（不含已取消的）
+        [[nodiscard]] std::size_t num_pending() const {
+            return core_->size();
+        }
+
+    private:
+        template <typename T, typename F>
+        timer_handle add(detail::timer_clock::time_point when, detail::timer_clock::duration period, F&& fn) {
+            using task_t = detail::timer_task<T, std::decay_t<F>>;
+            auto node = std::make_shared<task_t>(&br_, core_, std::decay_t<F>(std::forward<F>(fn)));
+            node->deadline = when;
+            node->period = period;
+            timer_handle handle(node, core_);
+            core_->schedule(std::move(node));
+            return handle;
+        }
+
+        template <typename Clock, typename Duration>
+        static detail::timer_clock::time_point to_steady(const std::chrono::time_point<Clock, Duration>& when) {
+            if constexpr (std::is_same_v<Clock, detail::timer_clock>)
+                return std::chrono::time_point_cast<detail::timer_clock::duration>(when);
+            else
+                return detail::timer_clock::now() +
+                       std::chrono::duration_cast<detail::timer_clock::duration>(when - Clock::now());
+        }
+    };
+
+}
+
+#endif //TIMER_H
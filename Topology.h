@@ -0,0 +1,154 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// 定义 TP_USE_LIBNUMA 并链接 -lnuma 时用 libnuma 查询拓扑，并让工作线程优先在本节点分配内存；
+// 否则在 Linux 上读取 /sys/devices/system/node，其他平台视为只有一个节点
+#ifdef TP_USE_LIBNUMA
+#include <numa.h>
+#endif
+
+namespace tp {
+    namespace topology {
+
+        namespace detail {
+            // 解析 "0-3,8-11" 形式的 CPU 列表
+            inline std::vector<unsigned> parse_cpu_list(const std::string& s) {
+                std::vector<unsigned> cpus;
+                std::size_t i = 0;
+                while(i < s.size()) {
+                    std::size_t j = s.find(',', i);
+                    if(j == std::string::npos)
+                        j = s.size();
+                    std::string part = s.substr(i, j - i);
+                    i = j + 1;
+                    if(part.empty() || part[0] < '0' || part[0] > '9')
+                        continue;
+                    std::size_t dash = part.find('-');
+                    unsigned lo = static_cast<unsigned>(std::stoul(part.substr(0, dash)));
+                    unsigned hi = dash == std::string::npos ? lo : static_cast<unsigned>(std::stoul(part.substr(dash + 1)));
+                    for(unsigned c = lo; c <= hi; ++c)
+                        cpus.push_back(c);
+                }
+                return cpus;
+            }
+
+            // 每个节点的 CPU 列表，第一次使用时探测，之后不再变化
+            inline const std::vector<std::vector<unsigned>>& nodes() {
+                static const std::vector<std::vector<unsigned>> table = [] {
+                    std::vector<std::vector<unsigned>> t;
+#if defined(TP_USE_LIBNUMA)
+                    if(numa_available() >= 0) {
+                        t.resize(static_cast<std::size_t>(numa_max_node()) + 1);
+                        for(int c = 0; c < numa_num_configured_cpus(); ++c) {
+                            int n = numa_node_of_cpu(c);
+                            if(n >= 0)
+                                t[static_cast<std::size_t>(n)].push_back(static_cast<unsigned>(c));
+                        }
+                    }
+#elif defined(__linux__)
+                    for(int n = 0;; ++n) {
+                        std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+                        if(!in)
+                            break;
+                        std::string line;
+                        std::getline(in, line);
+                        t.push_back(parse_cpu_list(line));
+                    }
+#endif
+                    if(t.empty()) {  // 无法探测时视为一个包含所有 CPU 的节点
+                        t.emplace_back();
+                        for(unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c)
+                            t.back().push_back(c);
+                    }
+                    return t;
+                }();
+                return table;
+            }
+
+            inline const std::vector<int>& cpu_to_node() {
+                static const std::vector<int> table = [] {
+                    std::vector<int> t;
+                    const auto& ns = nodes();
+                    for(std::size_t n = 0; n < ns.size(); ++n) {
+                        for(unsigned c : ns[n]) {
+                            if(c >= t.size())
+                                t.resize(c + 1, 0);
+                            t[c] = static_cast<int>(n);
+                        }
+                    }
+                    return t;
+                }();
+                return table;
+            }
+        }
+
+        [[nodiscard]] inline int num_nodes() {
+            return static_cast<int>(detail::nodes().size());
+        }
+
+        // 节点上的 CPU 编号，节点不存在时为空
+        [[nodiscard]] inline std::vector<unsigned> node_cpus(int node) {
+            const auto& ns = detail::nodes();
+            if(node < 0 || static_cast<std::size_t>(node) >= ns.size())
+                return {};
+            return ns[static_cast<std::size_t>(node)];
+        }
+
+        // 调用线程当前所在的节点；线程可能随时被迁移，结果只作为路由提示
+        [[nodiscard]] inline int current_node() {
+#if defined(__linux__)
+            int cpu = sched_getcpu();
+            const auto& t = detail::cpu_to_node();
+            if(cpu >= 0 && static_cast<std::size_t>(cpu) < t.size())
+                return t[static_cast<std::size_t>(cpu)];
+#endif
+            return 0;
+        }
+
+        // 把调用线程绑定到给定的 CPU 集合，不支持的平台或设置失败时返回 false
+        inline bool pin_current_thread(const std::vector<unsigned>& cpus) {
+#if defined(__linux__)
+            if(cpus.empty())
+                return false;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(unsigned c : cpus)
+                if(c < CPU_SETSIZE)
+                    CPU_SET(c, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            (void)cpus;
+            return false;
+#endif
+        }
+
+        // 让调用线程之后的内存分配优先落在 node 上；没有 libnuma 时依赖首次访问（first-touch）策略，什么也不做
+        inline void prefer_node_memory(int node) {
+#if defined(TP_USE_LIBNUMA)
+            if(node >= 0 && numa_available() >= 0)
+                numa_set_preferred(node);
+#else
+            (void)node;
+#endif
+        }
+
+    }
+}
+
+#endif //TOPOLOGY_H
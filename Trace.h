@@ -0,0 +1,266 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 任务时间线追踪。只有定义了 TP_ENABLE_TRACE 时埋点才会被编译进来，否则 TP_TRACE 展开为空语句，没有任何开销；
+// 编译进来之后还需要运行期调用 tp::trace::start() 才开始记录。每个线程写自己的环形缓冲区，满了覆盖最旧的事件
+#ifndef TP_TRACE_BUFFER_SIZE
+#define TP_TRACE_BUFFER_SIZE 16384  // 每个线程保留的事件数，必须是 2 的幂
+#endif
+
+#ifdef TP_ENABLE_TRACE
+#define TP_TRACE(...) ::tp::trace::emit(__VA_ARGS__)
+#define TP_TRACE_THREAD_NAME(name) ::tp::trace::set_thread_name(name)
+#else
+#define TP_TRACE(...) ((void)0)
+#define TP_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+namespace tp {
+    namespace trace {
+
+        enum class event : std::uint32_t {
+            enqueue,         // 提交任务，arg 为任务数
+            task_begin,
+            task_end,
+            steal,           // 窃取成功，arg 为被窃取线程的下标
+            park,            // 开始休眠
+            park_end,        // 被唤醒
+            unpark,          // 唤醒休眠线程，arg 为请求唤醒的线程数
+            worker_added,    // Supervisor 扩容，arg 为分支地址
+            worker_removed   // Supervisor 缩容，arg 为分支地址
+        };
+
+        namespace detail {
+            static_assert((TP_TRACE_BUFFER_SIZE & (TP_TRACE_BUFFER_SIZE - 1)) == 0, "TP_TRACE_BUFFER_SIZE must be a power of two");
+
+            struct record {
+                std::uint64_t ts;
+                std::uint64_t arg;
+                event kind;
+            };
+
+            inline std::uint64_t now_ns() noexcept {
+                return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+            }
+
+            // 单写者环形缓冲区：只有所属线程写入，导出时读取 head 之前的事件
+            class buffer {
+                static constexpr std::uint64_t mask = TP_TRACE_BUFFER_SIZE - 1;
+
+                std::unique_ptr<record[]> events_{new record[TP_TRACE_BUFFER_SIZE]};
+                std::atomic<std::uint64_t> head_{0};
+
+            public:
+                const std::uint32_t tid;
+                std::string name;
+                std::atomic<bool> retired{false};  // 所属线程已退出
+
+                buffer(std::uint32_t id, std::string n) : tid(id), name(std::move(n)) {}
+
+                void push(event kind, std::uint64_t arg) noexcept {
+                    std::uint64_t h = head_.load(std::memory_order_relaxed);
+                    record& r = events_[h & mask];
+                    r.ts = now_ns();
+                    r.arg = arg;
+                    r.kind = kind;
+                    head_.store(h + 1, std::memory_order_release);
+                }
+
+                template <typename Fn>
+                void for_each(Fn&& fn) const {
+                    std::uint64_t h = head_.load(std::memory_order_acquire);
+                    for(std::uint64_t i = h > mask ? h - mask - 1 : 0; i < h; ++i)
+                        fn(events_[i & mask]);
+                }
+
+                void reset() noexcept { head_.store(0, std::memory_order_relaxed); }
+            };
+
+            class registry {
+                std::mutex mtx_;
+                std::vector<std::unique_ptr<buffer>> buffers_;
+                std::uint32_t next_tid_ = 1;
+
+            public:
+                std::atomic<bool> enabled{false};
+                std::atomic<std::uint64_t> origin{0};  // 导出时间戳的零点
+
+                static registry& instance() {
+                    static registry r;
+                    return r;
+                }
+
+                buffer* attach(std::string name) {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    std::uint32_t id = next_tid_++;
+                    if(name.empty())
+                        name = "thread " + std::to_string(id);
+                    buffers_.emplace_back(std::make_unique<buffer>(id, std::move(name)));
+                    return buffers_.back().get();
+                }
+
+                template <typename Fn>
+                void for_each(Fn&& fn) {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    for(auto& b : buffers_)
+                        fn(*b);
+                }
+
+                // 丢弃已退出线程的缓冲区，清空其余缓冲区；只能在 stop() 之后调用
+                void clear() {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    std::vector<std::unique_ptr<buffer>> live;
+                    for(auto& b : buffers_) {
+                        if(!b->retired.load(std::memory_order_acquire)) {
+                            b->reset();
+                            live.emplace_back(std::move(b));
+                        }
+                    }
+                    buffers_ = std::move(live);
+                }
+            };
+
+            // 线程退出时把缓冲区标记为可回收，事件仍然保留到下一次 clear()
+            struct thread_slot {
+                buffer* buf = nullptr;
+                std::string pending_name;
+                ~thread_slot() {
+                    if(buf)
+                        buf->retired.store(true, std::memory_order_release);
+                }
+            };
+
+            inline thread_slot& slot() {
+                static thread_local thread_slot s;
+                return s;
+            }
+
+            // 快速路径只读一个平凡的线程局部指针，避免带析构函数的 thread_local 每次访问的初始化检查
+            inline thread_local buffer* tls_buffer = nullptr;
+
+            inline buffer* attach_current() {
+                thread_slot& s = slot();
+                if(!s.buf)
+                    s.buf = registry::instance().attach(std::move(s.pending_name));
+                tls_buffer = s.buf;
+                return s.buf;
+            }
+
+            inline void write_escaped(std::ostream& os, const std::string& s) {
+                for(char c : s) {
+                    if(c == '"' || c == '\\')
+                        os << '\\';
+                    os << c;
+                }
+            }
+        }
+
+        inline void start() {
+            auto& r = detail::registry::instance();
+            std::uint64_t expected = 0;
+            r.origin.compare_exchange_strong(expected, detail::now_ns());
+            r.enabled.store(true, std::memory_order_release);
+        }
+
+        inline void stop() {
+            detail::registry::instance().enabled.store(false, std::memory_order_release);
+        }
+
+        [[nodiscard]] inline bool enabled() {
+            return detail::registry::instance().enabled.load(std::memory_order_relaxed);
+        }
+
+        // 清空已记录的事件；调用前先 stop()，并确保没有线程还在记录
+        inline void clear() {
+            detail::registry::instance().clear();
+        }
+
+        inline void emit(event kind, std::uint64_t arg = 0) {
+            if(!detail::registry::instance().enabled.load(std::memory_order_relaxed))
+                return;
+            detail::buffer* b = detail::tls_buffer;
+            (b ? b : detail::attach_current())->push(kind, arg);
+        }
+
+        // 设置当前线程在时间线上显示的名字，在线程记录第一个事件之前调用才生效
+        inline void set_thread_name(std::string name) {
+            detail::thread_slot& s = detail::slot();
+            if(s.buf)
+                return;
+            s.pending_name = std::move(name);
+        }
+
+        // 导出为 Chrome trace JSON（chrome://tracing 或 ui.perfetto.dev 可以直接打开）
+        // 应在 stop() 之后、没有线程还在记录时调用
+        inline void dump(std::ostream& os) {
+            auto& r = detail::registry::instance();
+            const std::uint64_t origin = r.origin.load(std::memory_order_relaxed);
+            bool first = true;
+            auto begin = [&](const char* name, const char* ph, std::uint32_t tid) {
+                os << (first ? "\n    " : ",\n    ") << "{\"name\": \"" << name << "\", \"ph\": \"" << ph
+                   << "\", \"pid\": 1, \"tid\": " << tid;
+                first = false;
+            };
+            os << "{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [";
+            r.for_each([&](const detail::buffer& b) {
+                begin("thread_name", "M", b.tid);
+                os << ", \"args\": {\"name\": \"";
+                detail::write_escaped(os, b.name);
+                os << "\"}}";
+                b.for_each([&](const detail::record& e) {
+                    const char* name = "task";
+                    const char* ph = "i";
+                    const char* arg = nullptr;
+                    switch(e.kind) {
+                        case event::enqueue: name = "enqueue"; arg = "count"; break;
+                        case event::task_begin: ph = "B"; break;
+                        case event::task_end: ph = "E"; break;
+                        case event::steal: name = "steal"; arg = "victim"; break;
+                        case event::park: name = "parked"; ph = "B"; break;
+                        case event::park_end: name = "parked"; ph = "E"; break;
+                        case event::unpark: name = "unpark"; arg = "count"; break;
+                        case event::worker_added: name = "worker_added"; arg = "branch"; break;
+                        case event::worker_removed: name = "worker_removed"; arg = "branch"; break;
+                    }
+                    begin(name, ph, b.tid);
+                    double ts = e.ts > origin ? static_cast<double>(e.ts - origin) / 1000.0 : 0.0;
+                    os << ", \"ts\": " << std::fixed << ts;
+                    os.unsetf(std::ios_base::floatfield);
+                    if(*ph == 'i')
+                        os << ", \"s\": \"t\"";
+                    if(arg)
+                        os << ", \"args\": {\"" << arg << "\": " << e.arg << "}";
+                    os << "}";
+                });
+            });
+            os << "\n  ]\n}\n";
+        }
+
+        inline bool dump(const std::string& path) {
+            std::ofstream out(path);
+            if(!out)
+                return false;
+            dump(out);
+            return static_cast<bool>(out);
+        }
+
+    }
+}
+
+#endif //TRACE_H
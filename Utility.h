@@ -7,6 +7,7 @@
 
 #include <type_traits>
 #include <deque>
+#include <functional>
 #include <future>
 #include <vector>
 
@@ -36,11 +37,37 @@ struct normal{};
 struct urgent{};
 struct sequence{};
 
+// 多级优先级：priority<0> 最高，级数由 tp::branch_options::priority_levels 指定；urgent 等同于 priority<0>
+// 每一级内部先进先出，所有优先级都排在 normal 之前（weighted 策略下按权重轮流服务）
+template <unsigned N>
+struct priority{};
+
+template <typename T>
+struct is_prioritized : std::false_type {};
+template <>
+struct is_prioritized<urgent> : std::true_type {};
+template <unsigned N>
+struct is_prioritized<priority<N>> : std::true_type {};
+
+// 提交标签对应的优先级，normal 为 -1
 template <typename T>
+struct priority_of : std::integral_constant<int, -1> {};
+template <>
+struct priority_of<urgent> : std::integral_constant<int, 0> {};
+template <unsigned N>
+struct priority_of<priority<N>> : std::integral_constant<int, static_cast<int>(N)> {};
+
+// 可以用于 submit<T> 的单任务标签
+template <typename T>
+inline constexpr bool is_queue_tag_v = std::is_same_v<T, normal> || is_prioritized<T>::value;
+
+// Future 默认为 std::future，也可以是 tp::future 等提供 wait()/get() 的类型
+template <typename T, template <typename> class Future = std::future>
 class futures {
-    std::deque<std::future<T>> futs_;
+    std::deque<Future<T>> futs_;
 public:
-    using iterator = typename std::deque<std::future<T>>::iterator;
+    using future_type = Future<T>;
+    using iterator = typename std::deque<Future<T>>::iterator;
 
     void wait() {
         for(auto& f:futs_)
@@ -60,26 +87,26 @@ public:
 
     iterator begin() {return futs_.begin();}
     iterator end() {return futs_.end();}
-    void add_back(std::future<T>&& fut) {
+    void add_back(Future<T>&& fut) {
         futs_.emplace_back(std::move(fut));
     }
-    void add_front(std::future<T>&& fut) {
+    void add_front(Future<T>&& fut) {
         futs_.emplace_front(std::move(fut));
     }
 
-    void for_each(const iterator& first, std::function<void(std::future<T>&)> deal) {
+    void for_each(const iterator& first, std::function<void(Future<T>&)> deal) {
         for(auto it=first; it!=end(); ++it) {
             deal(*it);
         }
     }
 
-    void for_each(const iterator& first, const iterator& last, std::function<void(std::future<T>&)> deal) {
+    void for_each(const iterator& first, const iterator& last, std::function<void(Future<T>&)> deal) {
         for(auto it=first; it!=last; ++it) {
             deal(*it);
         }
     }
 
-    auto operator[](std::size_t idx) -> std::future<T>& {
+    auto operator[](std::size_t idx) -> Future<T>& {
         return futs_[idx];
     }
 
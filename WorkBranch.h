@@ -9,33 +9,195 @@
 
 #include "AutoThread.h"
 #include "BlockingQueue.h"
+#include "Cancellation.h"
+#include "Metrics.h"
+#include "Parker.h"
+#include "RingQueue.h"
+#include "SlabResource.h"
+#include "Task.h"
+#include "Topology.h"
 #include "Utility.h"
+#include "WorkStealingDeque.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 #include <functional>
+#include <iterator>
 #include <stdexcept>
-#include <iostream>
 
 namespace tp {
+    // 任务队列为空时工作线程的等待策略
+    enum class idle_strategy {
+        spin,            // 一直自旋并让出时间片，唤醒延迟最低，但空闲时占满 CPU
+        spin_then_park,  // 先自旋 spin_rounds 轮，仍无任务则休眠，由 submit 唤醒
+        park             // 队列为空立即休眠
+    };
+
+    // 共享任务队列的实现
+    enum class queue_backend {
+        blocking,  // BlockingQueue：互斥锁 + std::deque，无界
+        ring       // RingQueue：有界无锁环形队列，满时外部提交者阻塞等待（try_submit 和 reject 策略下改为拒绝）
+    };
+
+    // 多级优先级之间的调度策略
+    enum class priority_policy {
+        strict,   // 总是先取最高的非空级别，高优先级任务持续到来时低级别会饿死
+        weighted  // 加权轮转：各级（包括 normal）按 priority_weights 的比例轮流服务，低级别也能持续推进
+    };
+
+    // 排队任务数达到 branch_options::capacity 时如何处理新任务
+    enum class overflow_policy {
+        block,        // 提交者等待空位；工作线程向自己所在的分支提交时不等待，超额入队
+        reject,       // submit 抛出 std::runtime_error，try_submit 返回 rejected
+        caller_runs,  // 在提交者的线程上直接执行新任务
+        drop_oldest   // 丢弃最早入队的任务（normal 先于各优先级，低优先级先于高优先级），其 future 以 broken_promise 结束；
+                      // 经 dispatch 提交的调度器内部任务不会被丢弃
+    };
+
+    // try_submit 的结果
+    enum class submit_status {
+        accepted,       // 已入队
+        rejected,       // 队列或 ring 后端已满，任务未执行也未入队（block 策略下 try_submit 不等待，同样返回它）
+        caller_ran,     // 已在调用线程上执行完
+        dropped_oldest  // 已入队，为此丢弃了一个更早的任务
+    };
+
+    struct branch_options {
+        idle_strategy idle = idle_strategy::spin_then_park;
+        unsigned spin_rounds = 2048;  // spin_then_park 下休眠前的自旋轮数
+        // 工作窃取：每个线程持有本地 Chase-Lev 队列，工作线程内提交的任务进入本地队列，
+        // 外部提交进入共享注入队列，空闲线程随机窃取其他线程的任务
+        bool work_stealing = false;
+        queue_backend backend = queue_backend::blocking;
+        std::size_t ring_capacity = 4096;  // ring 后端的容量，向上取整为 2 的幂
+        // 统计执行/自旋/休眠时间和排队延迟直方图，每个任务多读两次时钟；计数类统计始终开启
+        bool collect_timing = false;
+        // del_worker 缩容的线程先进入备用池，add_worker 优先复用，免去创建线程、分配栈和初始化线程局部变量的开销；
+        // 在备用池中超过这个时间仍未被复用才真正退出，为 0 时缩容的线程立即退出
+        std::chrono::milliseconds standby_timeout{10000};
+        // 线程绑定：cpu_affinity 非空时每个工作线程绑定到这些 CPU；否则 numa_node >= 0 时绑定到该节点的全部 CPU
+        std::vector<unsigned> cpu_affinity;
+        int numa_node = -1;
+        // 优先级级数，可用 priority<0> ~ priority<priority_levels - 1>，每级一个先进先出队列
+        unsigned priority_levels = 1;
+        priority_policy policy = priority_policy::strict;
+        // weighted 下 priority<0> ~ priority<priority_levels - 1> 和 normal 的权重，共 priority_levels + 1 项；
+        // 为空时每高一级权重翻倍（最多 1024 倍）
+        std::vector<unsigned> priority_weights;
+        // 所有队列中排队（尚未开始执行）的任务总数上限，为 0 时不限制；达到上限后按 overflow 处理
+        std::size_t capacity = 0;
+        overflow_policy overflow = overflow_policy::block;
+        // 队列内存块、future 共享状态、工作窃取的任务节点和放不进 Task 内部的大任务从这里分配，必须线程安全且比分支活得更久；
+        // 为空时使用 default_slab_resource()
+        std::pmr::memory_resource* memory = nullptr;
+        // 返回 void 的任务抛出而未被捕获的异常（有返回值的任务交给它的 future）：设置了 error_handler 时
+        // 在抛出异常的线程上调用它，否则存入容量为 error_capacity 的无锁环形队列，满时丢弃最早的一个，
+        // 由 pop_error / take_errors 取出；为 0 时只计数。都不经过 iostream，不会让出错的线程互相串行化
+        std::function<void(std::exception_ptr)> error_handler;
+        std::size_t error_capacity = 64;
+    };
+
+    class strand;
+
     class WorkBranch {
+        friend class strand;  // 复用任务的异常处理
         using worker = AutoThread<detach>;
         using worker_map = std::map<worker::id, worker>;
+        using task_node = Task*;
+
+        // 每个线程的上下文，线程退出后留给新线程复用，分支析构时才释放
+        struct worker_ctx {
+            WorkStealingDeque<task_node> local;
+            const WorkBranch* owner = nullptr;
+            std::uint64_t seed = 0;   // 选择窃取对象的随机数状态
+            std::uint32_t ticks = 0;  // 调度计数，周期性检查共享队列
+            std::uint32_t turn = 0;   // weighted 策略下在轮转表中的位置
+            std::atomic<bool> active{false};
+            detail::metrics_block metrics;  // 只由使用本上下文的线程写入
+        };
+        // 备用池中的线程在自己栈上的记录，由 mtx_ 保护
+        struct standby_slot {
+            std::condition_variable cv;
+            worker thread{std::thread()};
+            bool revived = false;
+        };
+        // 一个优先级的队列，size 让取任务时不加锁就能跳过空的级别
+        struct alignas(64) level_queue {
+            BlockingQueue<Task> tasks;
+            std::atomic<std::size_t> size{0};
+            explicit level_queue(std::pmr::memory_resource* mr) : tasks(mr) {}
+        };
+        // 外部线程提交时 ring 后端已满：等待空位、溢出到互斥队列，或放弃入队
+        enum class ring_full { wait, spill, fail };
+        static constexpr std::size_t max_ctx_workers = 1024;
+        static constexpr unsigned max_priority_levels = 64;
+        static constexpr std::size_t max_schedule_length = 1 << 16;
+        static constexpr std::uint32_t global_check_interval = 61;
+        static constexpr unsigned help_spin_rounds = 256;
+        static constexpr std::chrono::microseconds help_sleep{50};
+        inline static thread_local worker_ctx* current_ = nullptr;
+        inline static thread_local WorkBranch* executing_ = nullptr;  // 正在为哪个分支执行任务，用于报告异常
 
     private:
         worker_map workers_{};
-        BlockingQueue<std::function<void()>> tasks_{};
+        std::atomic<std::size_t> num_workers_{0};  // workers_.size() 的无锁副本，随 workers_ 一起在 mtx_ 下更新
+        std::vector<standby_slot*> standby_;  // 后进先出，优先复用最近退下的线程
+        std::pmr::memory_resource* const mr_;
+        BlockingQueue<Task> tasks_;  // 共享队列（工作窃取模式下作为注入队列）
+        // ring 后端：普通任务走无锁环形队列，tasks_ 只存放工作线程提交时溢出的任务
+        std::unique_ptr<RingQueue<Task>> ring_;
+        const branch_options opts_;
+        std::vector<std::unique_ptr<level_queue>> levels_;  // priority<0> ~ priority<n-1>，urgent 进入第 0 级
+        std::vector<unsigned> schedule_;  // weighted 策略的轮转表，元素为级别，priority_levels 表示 normal
+        std::atomic<std::size_t> prioritized_{0};  // 各优先级队列中的任务总数，为 0 时取任务只多一次读
+        Parker parker_;  // 空闲线程在此休眠，submit 时唤醒
+
+        std::vector<std::unique_ptr<worker_ctx>> ctx_pool_;  // 由 mtx_ 保护
+        std::unique_ptr<std::atomic<worker_ctx*>[]> victims_;
+        std::atomic<std::size_t> num_victims_{0};
+        std::atomic<std::uint64_t> external_tasks_{0};       // 非本分支线程帮忙执行的任务数
+        std::atomic<std::uint64_t> external_exceptions_{0};
+        std::atomic<std::uint64_t> rejected_{0};
+        std::atomic<std::uint64_t> dropped_{0};
+        std::unique_ptr<RingQueue<std::exception_ptr>> errors_;  // 未设置 error_handler 时保存未捕获的异常
+        std::atomic<std::uint64_t> errors_dropped_{0};
 
         std::mutex mtx_;
-        std::condition_variable thread_cv_;  // 通知，有任务到来
-        std::condition_variable task_done_;  // 通知，有空闲进程
+        std::condition_variable thread_cv_;  // 通知，有线程退出
+        std::condition_variable task_done_;  // 通知，所有任务已完成
+        std::condition_variable space_cv_;   // 通知，队列有了空位
 
-        std::size_t decline_ = 0;  // 需要减少进程的数量
-        std::size_t task_done_workers_ = 0;  // 空闲进程数量
-        bool is_waiting_ = false;   // 线程池是否正在等待所有任务完成。
+        std::atomic<std::size_t> decline_{0};  // 需要减少进程的数量
+        std::atomic<std::size_t> in_flight_{0};  // 已提交但尚未执行完的任务数（排队中 + 执行中）
+        std::atomic<std::size_t> num_waiters_{0};  // 正在 wait_tasks 中等待的线程数
+        std::atomic<std::size_t> num_helpers_{0};  // 在 help_until 中休眠的线程数
+        std::atomic<std::size_t> queued_{0};   // 设置了 capacity 时排队中的任务数，入队前占位、出队后释放
+        std::atomic<std::size_t> num_blocked_{0};  // 正在等待空位的提交者数
         bool destructing_ = false;  // 线程池是否正在被析构。
 
     public:
-        explicit WorkBranch(int wks=1) {
-            for(int i = 0; i <= std::max(wks, 1); ++i)
+        explicit WorkBranch(int wks = 1, const branch_options& opts = {})
+            : mr_(opts.memory ? opts.memory : default_slab_resource())
+            , tasks_(mr_)
+            , opts_(opts) {
+            if(opts_.numa_node >= topology::num_nodes())
+                throw std::invalid_argument("workspace: NUMA node out of range");
+            if(opts_.priority_levels == 0 || opts_.priority_levels > max_priority_levels)
+                throw std::invalid_argument("workspace: priority_levels must be in [1, 64]");
+            for(unsigned i = 0; i < opts_.priority_levels; ++i)
+                levels_.emplace_back(std::make_unique<level_queue>(mr_));
+            if(opts_.policy == priority_policy::weighted)
+                schedule_ = make_schedule();
+            victims_.reset(new std::atomic<worker_ctx*>[max_ctx_workers]);
+            if(opts_.backend == queue_backend::ring)
+                ring_ = std::make_unique<RingQueue<Task>>(opts_.ring_capacity);
+            if(!opts_.error_handler && opts_.error_capacity > 0)
+                errors_ = std::make_unique<RingQueue<std::exception_ptr>>(std::max<std::size_t>(opts_.error_capacity, 2));
+            for(int i = 0; i < std::max(wks, 1); ++i)
                 add_worker();
         }
 
@@ -45,45 +207,147 @@ namespace tp {
             std::unique_lock<std::mutex> lock(mtx_);
             decline_ = workers_.size();
             destructing_ = true;
-            thread_cv_.wait(lock, [this](){return !decline_;});
+            parker_.unpark_all();
+            for(auto* slot : standby_)
+                slot->cv.notify_one();
+            thread_cv_.notify_all();
+            space_cv_.notify_all();
+            thread_cv_.wait(lock, [this](){return workers_.empty() && standby_.empty();});
         }
 
     public:
+        // 依次尝试：撤销一个尚未生效的 del_worker、唤醒备用池中的线程、创建新线程
         void add_worker() {
             std::lock_guard<std::mutex> lock(mtx_);
+            std::size_t pending = decline_.load(std::memory_order_relaxed);
+            if(pending > 0 && pending <= workers_.size()) {  // 仍有存活线程等着退出，撤销其中一个
+                --decline_;
+                return;
+            }
+            if(!standby_.empty()) {
+                standby_slot* slot = standby_.back();
+                standby_.pop_back();
+                slot->revived = true;
+                auto id = slot->thread.get_id();
+                workers_.emplace(id, std::move(slot->thread));
+                num_workers_.store(workers_.size(), std::memory_order_relaxed);
+                slot->cv.notify_one();
+                return;
+            }
             std::thread t(&WorkBranch::mission, this);
             workers_.emplace(t.get_id(), std::move(t));
+            num_workers_.store(workers_.size(), std::memory_order_relaxed);
         }
 
+        // 每个存活线程最多对应一个尚未生效的 del_worker，否则多出的减员会吞掉之后的 add_worker
         void del_worker() {
             std::lock_guard<std::mutex> lock(mtx_);
-            if(workers_.empty()) {
+            if(decline_.load(std::memory_order_relaxed) >= workers_.size()) {
                 throw std::runtime_error("workspace: No worker in workbranch to delete");
             }
             ++decline_;
+            parker_.unpark_all();
         }
 
-        bool wait_tasks(unsigned timeout=1) {
-            bool res;
-            {
-                std::unique_lock<std::mutex> lock(mtx_);
-                is_waiting_ = true;
-                res = task_done_.wait_for(lock, std::chrono::microseconds(timeout), [this]() {
-                    return task_done_workers_ >= workers_.size();
-                });
-                task_done_workers_ = 0;
-                is_waiting_ = false;
-            }
-            thread_cv_.notify_all();
-            return res;
+        // 阻塞直到所有已提交的任务（包括执行期间新提交的任务）都执行完毕
+        void wait_tasks() {
+            wait_until_quiescent([](std::unique_lock<std::mutex>& lock, std::condition_variable& cv, auto pred) {
+                cv.wait(lock, pred);
+                return true;
+            });
+        }
+
+        // 最多等待 timeout，超时仍有任务未完成时返回 false
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+            return wait_until_quiescent([&](std::unique_lock<std::mutex>& lock, std::condition_variable& cv, auto pred) {
+                return cv.wait_for(lock, timeout, pred);
+            });
+        }
+
+        // 兼容旧接口，timeout 以微秒为单位
+        bool wait_tasks(unsigned timeout) {
+            return wait_for(std::chrono::microseconds(timeout));
+        }
+
+        // 已提交但尚未执行完的任务数
+        [[nodiscard]] std::size_t num_in_flight() const {
+            return in_flight_.load(std::memory_order_acquire);
+        }
+        // 不计已被 del_worker 要求退出、但还没来得及退出的线程，Supervisor 据此判断是否已缩到 min_workers
+        [[nodiscard]] std::size_t num_workers() const {
+            std::size_t n = num_workers_.load(std::memory_order_relaxed);
+            std::size_t d = decline_.load(std::memory_order_relaxed);
+            return n > d ? n - d : 0;
+        }
+        // 构造时指定的 NUMA 节点，未指定时为 -1
+        [[nodiscard]] int numa_node() const noexcept {
+            return opts_.numa_node;
+        }
+        // 分支使用的内存资源，见 branch_options::memory
+        [[nodiscard]] std::pmr::memory_resource* memory_resource() const noexcept {
+            return mr_;
         }
-        std::size_t num_workers() {
+        // 备用池中等待复用的线程数，不计入 num_workers()
+        std::size_t num_standby() {
             std::lock_guard<std::mutex> lock(mtx_);
-            return workers_.size();
+            return standby_.size();
         }
         std::size_t num_tasks() {
             std::lock_guard<std::mutex> lock(mtx_);
-            return tasks_.size();
+            return num_shared_tasks() + num_local_tasks();
+        }
+
+        // 各线程统计的快照：只读取原子计数器，不加锁，可以周期性采集而不影响工作线程
+        [[nodiscard]] branch_metrics metrics() const {
+            branch_metrics out;
+            std::uint64_t now = detail::now_ns();
+            std::size_t n = num_victims_.load(std::memory_order_acquire);
+            out.workers.reserve(n);
+            for(std::size_t i = 0; i < n; ++i) {
+                out.workers.push_back(victims_[i].load(std::memory_order_acquire)->metrics.snapshot(now));
+                out.total += out.workers.back();
+            }
+            out.external.tasks_executed = external_tasks_.load(std::memory_order_relaxed);
+            out.external.exceptions = external_exceptions_.load(std::memory_order_relaxed);
+            out.total += out.external;
+            out.in_flight = in_flight_.load(std::memory_order_relaxed);
+            out.rejected = rejected_.load(std::memory_order_relaxed);
+            out.dropped = dropped_.load(std::memory_order_relaxed);
+            out.errors_dropped = errors_dropped_.load(std::memory_order_relaxed);
+            return out;
+        }
+
+        // 记录一个未被捕获的异常：交给 error_handler，或存入错误队列（满时丢弃最早的一个）
+        void report_error(std::exception_ptr e) noexcept {
+            if(opts_.error_handler) {
+                try {
+                    opts_.error_handler(std::move(e));
+                } catch (...) {}  // 处理函数自己抛出的异常无处可报，丢弃
+                return;
+            }
+            if(!errors_) {
+                errors_dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            while(errors_->try_push(e) == push_status::full) {
+                std::exception_ptr oldest;
+                if(errors_->try_pop(oldest))
+                    errors_dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // 取出最早的一个未处理的异常，没有时返回 false
+        bool pop_error(std::exception_ptr& e) {
+            return errors_ && errors_->try_pop(e);
+        }
+
+        std::vector<std::exception_ptr> take_errors() {
+            std::vector<std::exception_ptr> out;
+            std::exception_ptr e;
+            while(pop_error(e))
+                out.push_back(std::move(e));
+            return out;
         }
     public:
         // enable_if 限制模板的实例化条件
@@ -94,7 +358,7 @@ namespace tp {
             typename DR = std::enable_if_t<std::is_void_v<R>>
         >  // 当且仅当 R是void、T是normal时被实例化
         auto submit(F &&task) -> std::enable_if_t<std::is_same_v<T, normal>> {
-            tasks_.push_back(make_task_wrapper(std::forward<F>(task)));
+            push_task(make_task_wrapper(std::forward<F>(task)));
         }
 
         template<
@@ -102,9 +366,9 @@ namespace tp {
             typename F,
             typename R = result_of<F>,
             typename DR = std::enable_if_t<std::is_void_v<R>>
-            > // 当且仅当 R是void、T是urgent时被实例化
-        auto submit(F &&task) -> std::enable_if_t<std::is_same_v<T, urgent>> {
-            tasks_.push_front(make_task_wrapper(std::forward<F>(task)));
+            > // 当且仅当 R是void、T是urgent或priority<N>时被实例化
+        auto submit(F &&task) -> std::enable_if_t<is_prioritized<T>::value> {
+            push_task(make_task_wrapper(std::forward<F>(task)), priority_of<T>::value);
         }
 
         template <
@@ -113,9 +377,9 @@ namespace tp {
             typename ...Fs
             > // 当且仅当 R是void、T是sequence时被实例化
         auto submit(F&& task, Fs&& ...tasks) -> std::enable_if_t<std::is_same_v<T, sequence>> {
-            tasks_.push_back(
+            push_task(
                 make_task_wrapper(
-                    [=] {this->rexec(task, tasks...);}
+                    [this, task, tasks...] {this->rexec(task, tasks...);}
                     ));
         }
 
@@ -125,14 +389,14 @@ namespace tp {
             typename R = result_of<F>,
             typename DR = std::enable_if_t<!std::is_void_v<R>>
         > // 当且仅当R不是void、T是normal时被实例化
-        auto submit(F&& task, std::enable_if<std::is_same_v<T, normal>, normal> = {}) -> std::future<R> {
-            std::function<R()> exec(std::forward<F>(task));
-            std::shared_ptr<std::promise<R>> take_promise = std::make_shared<std::promise<R>>();
-            tasks_.push_back(
-                make_task_wrapper(
-                    [exec, take_promise]() { take_promise->set_value(exec());}
-                    ));
-            return take_promise->get_future();
+        auto submit(F&& task, std::enable_if_t<std::is_same_v<T, normal>, normal> = {}) -> std::future<R> {
+            // 结果的共享状态从 mr_ 分配，可调用对象随任务存放
+            std::promise<R> done = make_promise<R>();
+            std::future<R> fut = done.get_future();
+            push_task(make_task_wrapper([done = std::move(done), task = std::forward<F>(task)]() mutable {
+                fulfil(done, task);
+            }));
+            return fut;
         }
 
         template <
@@ -140,57 +404,845 @@ namespace tp {
             typename F,
             typename R = result_of<F>,
             typename DR = std::enable_if_t<!std::is_void_v<R>>
-        > // 当且仅当R不是void、T是urgent时被实例化
-        auto submit(F&& task, std::enable_if<std::is_same_v<T, urgent>, urgent> = {}) -> std::future<R> {
-            std::function<R()> exec(std::forward<F>(task));
-            std::shared_ptr<std::promise<R>> take_promise = std::make_shared<std::promise<R>>();
-            tasks_.push_front(make_task_wrapper(
-                [exec, take_promise]() {take_promise->set_value(exec());}
-                ));
-            return take_promise->get_future();
+        > // 当且仅当R不是void、T是urgent或priority<N>时被实例化
+        auto submit(F&& task, std::enable_if_t<is_prioritized<T>::value, T> = {}) -> std::future<R> {
+            std::promise<R> done = make_promise<R>();
+            std::future<R> fut = done.get_future();
+            push_task(make_task_wrapper([done = std::move(done), task = std::forward<F>(task)]() mutable {
+                fulfil(done, task);
+            }), priority_of<T>::value);
+            return fut;
+        }
+
+        // 不因队列已满而抛出异常或等待，返回任务的去向；capacity 为 0 时总是 accepted
+        template <
+            typename T = normal,
+            typename F,
+            typename R = result_of<F>,
+            typename = std::enable_if_t<std::is_void_v<R> && is_queue_tag_v<T>>
+        >
+        submit_status try_submit(F&& task) {
+            constexpr int level = priority_of<T>::value;
+            if(level >= 0)
+                check_level(level);
+            Task wrapped = make_task_wrapper(std::forward<F>(task));
+            submit_status s = opts_.capacity > 0 ? admit(wrapped, false) : submit_status::accepted;
+            if((s == submit_status::accepted || s == submit_status::dropped_oldest)
+               && !enqueue(std::move(wrapped), level, on_ring_full(false))) {
+                unadmit();
+                return submit_status::rejected;
+            }
+            return s;
+        }
+
+        // 调度器内部的提交（parallel_for 的分块、TaskGraph 的节点、TaskGroup、future 的后续任务、Timer、strand）：
+        // 不按 overflow 策略处理，设置了 capacity 时超额占位，也不等待 ring 后端的空位。
+        // 这些任务被拒绝、在提交者线程上执行或被丢弃，都会让等待它们的一方永远等下去，所以也标记为不可丢弃
+        template <
+            typename T = normal,
+            typename F,
+            typename = std::enable_if_t<is_queue_tag_v<T>>
+        >
+        void dispatch(F&& task) {
+            constexpr int level = priority_of<T>::value;
+            if(level >= 0)
+                check_level(level);
+            Task wrapped = make_task_wrapper(std::forward<F>(task));
+            wrapped.pin();
+            over_admit();
+            enqueue(std::move(wrapped), level, ring_full::spill);
+        }
+
+        // 可取消的提交：返回 {std::future, cancel_handle}。task 可以是 fn() 或 fn(stop_token)；
+        // 开始执行前被取消时不执行 task，future 以 task_cancelled 结束
+        template <
+            typename T = normal,
+            typename F,
+            typename R = detail::token_result_t<F>,
+            typename = std::enable_if_t<is_queue_tag_v<T>>
+        >
+        auto submit_cancellable(F&& task) -> cancellable<std::future<R>> {
+            auto st = std::allocate_shared<detail::cancel_state>(std::pmr::polymorphic_allocator<detail::cancel_state>(mr_));
+            std::promise<R> done = make_promise<R>();
+            cancellable<std::future<R>> out{done.get_future(), cancel_handle(st)};
+            push_task(make_task_wrapper(
+                [st = std::move(st), done = std::move(done), task = std::forward<F>(task)]() mutable {
+                    if(!st->begin()) {
+                        done.set_exception(std::make_exception_ptr(task_cancelled{}));
+                        return;
+                    }
+                    fulfil(done, [&]() -> R { return detail::invoke_with_token(task, st); });
+                }), priority_of<T>::value);
+            return out;
+        }
+
+        // co_await br.schedule() 把协程挂起，并在本分支的工作线程上恢复执行
+        // await_suspend 对句柄类型做成模板，核心部分不依赖 C++20 的 <coroutine>
+        class schedule_awaiter {
+            WorkBranch& br_;
+        public:
+            explicit schedule_awaiter(WorkBranch& br) noexcept : br_(br) {}
+            [[nodiscard]] bool await_ready() const noexcept { return false; }
+            template <typename Handle>
+            void await_suspend(Handle h) { br_.dispatch([h]() mutable { h.resume(); }); }
+            void await_resume() const noexcept {}
+        };
+
+        schedule_awaiter schedule() noexcept {
+            return schedule_awaiter{*this};
+        }
+
+        // 在调用线程上执行一个排队中的任务，没有可执行的任务时返回 false
+        // 等待本分支上的结果时用它帮忙干活，而不是阻塞一个线程
+        bool run_pending_task() {
+            Task task;
+            worker_ctx* ctx = current_ && current_->owner == this ? current_ : nullptr;
+            if(!pop_task(ctx, task))
+                return false;
+            execute(ctx, task);
+            return true;
+        }
+
+        // 在调用线程上执行排队中的任务，直到 pred() 为真；工作线程等待同一分支上的结果时不会占住线程，
+        // 嵌套的 fork-join 在很小的线程池上也不会死锁。没有可执行的任务时先自旋、再让出时间片，
+        // 最后和空闲的工作线程一起休眠，有新任务入队或 wake_helpers() 时醒来。帮忙执行的任务在调用者的栈上运行。
+        // 让 pred 变为真的一方必须随后调用 wake_helpers()；parallel_for 等并行算法、TaskGraph 和 TaskGroup 的 wait 都用它等待
+        template <typename Pred>
+        void help_until(Pred&& pred) {
+            help(pred, false);
+        }
+
+        // 唤醒 help_until 中休眠的线程，让它们重新检查等待条件；没有人休眠时只是一次栅栏和原子读
+        void wake_helpers() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // 与 help 中登记 num_helpers_ 后的栅栏配对
+            if(num_helpers_.load(std::memory_order_relaxed) > 0)
+                parker_.unpark_all();
+        }
+
+        // 等待 fut 就绪（之后再调用 get），等待期间帮本分支执行任务。
+        // 支持 std::future、std::shared_future 以及 tp::future 等提供 is_ready() 的类型；
+        // 结果就绪时没有人调用 wake_helpers()，所以每次最多休眠 help_sleep 后重新检查
+        template <typename Future>
+        void wait(const Future& fut) {
+            auto ready = [&fut] { return future_ready(fut); };
+            help(ready, true);
+        }
+
+        template <typename T, template <typename> class Future>
+        void wait(futures<T, Future>& futs) {
+            for(auto& f : futs)
+                wait(f);
+        }
+
+        // 批量提交：整批任务只加一次锁（ring 后端为一次 CAS），并按任务数唤醒休眠线程
+        // [first, last) 中的每个元素都是可调用对象；返回 void 时无返回值，否则返回 futures<R>
+        template <
+            typename T = normal,
+            typename It,
+            typename R = result_of<typename std::iterator_traits<It>::reference>,
+            typename = std::enable_if_t<is_queue_tag_v<T>>
+        >
+        auto submit_bulk(It first, It last) {
+            std::vector<Task> batch;
+            batch.reserve(static_cast<std::size_t>(std::distance(first, last)));
+            if constexpr (std::is_void_v<R>) {
+                for(; first != last; ++first)
+                    batch.emplace_back(make_task_wrapper(*first));
+                push_tasks(batch, priority_of<T>::value);
+            } else {
+                futures<R> futs;
+                for(; first != last; ++first) {
+                    std::promise<R> done = make_promise<R>();
+                    futs.add_back(done.get_future());
+                    batch.emplace_back(make_task_wrapper([done = std::move(done), task = *first]() mutable {
+                        fulfil(done, task);
+                    }));
+                }
+                push_tasks(batch, priority_of<T>::value);
+                return futs;
+            }
+        }
+
+        // 对 range 中的每个元素 e 提交 fn(e)；返回 void 时无返回值，否则返回 futures<R>
+        template <
+            typename T = normal,
+            typename Range,
+            typename F,
+            typename E = decltype(*std::begin(std::declval<Range&>())),
+            typename R = result_of<F&, E>,
+            typename = std::enable_if_t<is_queue_tag_v<T>>,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<Range>, std::decay_t<F>>>
+        >
+        auto submit_bulk(Range&& range, F&& fn) {
+            std::vector<Task> batch;
+            batch.reserve(static_cast<std::size_t>(std::distance(std::begin(range), std::end(range))));
+            if constexpr (std::is_void_v<R>) {
+                for(auto&& e : range)
+                    batch.emplace_back(make_task_wrapper([fn, e] () mutable { fn(e); }));
+                push_tasks(batch, priority_of<T>::value);
+            } else {
+                futures<R> futs;
+                for(auto&& e : range) {
+                    std::promise<R> done = make_promise<R>();
+                    futs.add_back(done.get_future());
+                    batch.emplace_back(make_task_wrapper([done = std::move(done), fn, e]() mutable {
+                        fulfil(done, [&] { return fn(e); });
+                    }));
+                }
+                push_tasks(batch, priority_of<T>::value);
+                return futs;
+            }
         }
 
     private:
-        void mission() {   // 每个线程任务，要么执行任务队列的任务，要么阻塞，要么析构
-            std::function<void()> task;
+        void mission() {   // 每个线程任务，要么执行任务队列的任务，要么自旋/休眠，要么析构
+            TP_TRACE_THREAD_NAME("WorkBranch worker");
+            bind_thread();
+            Task task;
+            unsigned idle_rounds = 0;
+            worker_ctx* ctx = attach_ctx();
             while(true) {
-                if(decline_ <= 0 && tasks_.try_pop(task))  // 尝试取出任务，并执行，但不阻塞
-                    task();
-                else if(decline_ > 0) {  // 析构
-                    std::lock_guard<std::mutex> lock(mtx_);
-                    if(decline_ > 0 && --decline_) {  // 双重检查
-                        workers_.erase(std::this_thread::get_id());
-                        if(is_waiting_)
-                            task_done_.notify_one();
+                if(decline_.load(std::memory_order_acquire) > 0) {  // 缩容或析构
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    if(decline_ > 0) {  // 双重检查
+                        --decline_;
+                        if(ctx)
+                            detach_ctx(ctx);
+                        if(!destructing_ && opts_.standby_timeout.count() > 0) {
+                            if(standby(lock)) {  // 被 add_worker 复用
+                                lock.unlock();
+                                ctx = attach_ctx();
+                                idle_rounds = 0;
+                                continue;
+                            }
+                        }
+                        else {
+                            workers_.erase(std::this_thread::get_id());
+                            num_workers_.store(workers_.size(), std::memory_order_relaxed);
+                        }
                         if(destructing_)
-                            thread_cv_.notify_one();
+                            thread_cv_.notify_all();
                         return;
                     }
                 }
-                else if(is_waiting_)
-                    {  // 阻塞
-                        std::unique_lock<std::mutex> lock(mtx_);
-                        ++task_done_workers_;
-                        task_done_.notify_one();
-                        thread_cv_.wait(lock);
-                    }
+                else if(pop_task(ctx, task)) {  // 尝试取出任务，并执行，但不阻塞
+                    execute(ctx, task);
+                    idle_rounds = 0;
+                }
                 else
+                    idle(idle_rounds);
+            }
+        }
+
+        // 按 branch_options 绑定当前线程，在 attach_ctx 之前调用，让线程上下文的内存首次访问就落在本节点
+        void bind_thread() const {
+            if(!opts_.cpu_affinity.empty())
+                topology::pin_current_thread(opts_.cpu_affinity);
+            else if(opts_.numa_node >= 0)
+                topology::pin_current_thread(topology::node_cpus(opts_.numa_node));
+            topology::prefer_node_memory(opts_.numa_node);
+        }
+
+        // 在备用池中等待，被 add_worker 复用时返回 true（此时已被放回 workers_）；
+        // 超时或分支析构时返回 false，线程句柄随 slot 析构而 detach
+        bool standby(std::unique_lock<std::mutex>& lock) {
+            standby_slot slot;
+            auto it = workers_.find(std::this_thread::get_id());
+            slot.thread = std::move(it->second);
+            workers_.erase(it);
+            num_workers_.store(workers_.size(), std::memory_order_relaxed);
+            standby_.push_back(&slot);
+            slot.cv.wait_for(lock, opts_.standby_timeout, [&] { return slot.revived || destructing_; });
+            if(slot.revived)
+                return true;
+            standby_.erase(std::find(standby_.begin(), standby_.end(), &slot));
+            return false;
+        }
+
+        void idle(unsigned& rounds) {
+            switch(opts_.idle) {
+                case idle_strategy::spin:
                     std::this_thread::yield(); // 让出时间片
+                    return;
+                case idle_strategy::spin_then_park:
+                    if(rounds < opts_.spin_rounds) {
+                        // 前半段只做 pause，保持微秒级唤醒延迟；后半段让出时间片
+                        if(++rounds < opts_.spin_rounds / 2)
+                            cpu_relax();
+                        else
+                            std::this_thread::yield();
+                        return;
+                    }
+                    break;
+                case idle_strategy::park:
+                    break;
+            }
+            rounds = 0;
+            detail::metrics_block* m = opts_.collect_timing && current_ ? &current_->metrics : nullptr;
+            if(m)
+                m->park_begin();
+            TP_TRACE(trace::event::park);
+            parker_.park([this] {
+                return num_shared_tasks() > 0 || num_local_tasks() > 0 || decline_.load() > 0;
+            });
+            TP_TRACE(trace::event::park_end);
+            if(m)
+                m->park_end();
+        }
 
+        // 执行一个任务并计数；统计块通过线程局部变量交给任务包装记录排队延迟、执行时间和异常
+        void execute(worker_ctx* ctx, Task& task) {
+            detail::metrics_block* saved_metrics = detail::current_metrics;
+            std::atomic<std::uint64_t>* saved_exceptions = detail::current_exceptions;
+            WorkBranch* saved_branch = executing_;
+            detail::current_metrics = ctx ? &ctx->metrics : nullptr;
+            detail::current_exceptions = ctx ? &ctx->metrics.exceptions : &external_exceptions_;
+            executing_ = this;
+            TP_TRACE(trace::event::task_begin);
+            task();
+            task.reset();  // 尽早释放任务捕获的资源
+            TP_TRACE(trace::event::task_end);
+            detail::current_metrics = saved_metrics;
+            detail::current_exceptions = saved_exceptions;
+            executing_ = saved_branch;
+            if(ctx)
+                ctx->metrics.tasks_executed.add();
+            else
+                external_tasks_.fetch_add(1, std::memory_order_relaxed);
+            finish_task();
+        }
+
+        // level < 0 为 normal，否则进入对应的优先级队列；设置了 capacity 时先按 overflow 策略占位
+        void push_task(Task&& task, int level = -1) {
+            if(level >= 0)
+                check_level(level);
+            if(opts_.capacity > 0) {
+                submit_status s = admit(task, true);
+                if(s == submit_status::rejected)
+                    throw std::runtime_error("workspace: task queue is full, see branch_options::capacity");
+                if(s == submit_status::caller_ran)
+                    return;
+            }
+            if(!enqueue(std::move(task), level, on_ring_full(true))) {
+                unadmit();
+                throw std::runtime_error("workspace: task queue is full, see branch_options::capacity");
             }
         }
 
-        template <typename F>
-        static std::function<void()> make_task_wrapper(F &&task) {
-            return [task]() {
-                try {
-                    task();
-                } catch (const std::exception& ex) {
-                    std::cerr<<"workspace: worker["<< std::this_thread::get_id()<<"] caught exception:\n  what(): "<<ex.what()<<'\n'<<std::flush;
-                } catch (...) {
-                    std::cerr<<"workspace: worker["<< std::this_thread::get_id()<<"] caught unknown exception\n"<<std::flush;
+        // 已占到位的任务遇到 ring 后端已满时的处理：只有 block 策略（或没有 capacity）的 submit 等待；
+        // reject 策略和 try_submit 拒绝；caller_runs / drop_oldest 的提交者从不等待，溢出到互斥队列
+        ring_full on_ring_full(bool wait) const {
+            if(opts_.capacity > 0 && opts_.overflow == overflow_policy::reject)
+                return ring_full::fail;
+            if(opts_.capacity > 0 && opts_.overflow != overflow_policy::block)
+                return ring_full::spill;
+            return wait ? ring_full::wait : ring_full::fail;
+        }
+
+        bool drops_oldest() const {
+            return opts_.capacity > 0 && opts_.overflow == overflow_policy::drop_oldest;
+        }
+
+        // 入队失败时归还 admit 占的空位，计为一次拒绝
+        void unadmit() {
+            if(opts_.capacity > 0)
+                release_slot();
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 只有外部线程遇到已满的 ring 后端、且 full 为 fail 时返回 false，此时任务未入队、task 保持不变；
+        // 工作线程不能等待自己所在的分支，总是溢出到互斥队列
+        bool enqueue(Task&& task, int level, ring_full full = ring_full::wait) {
+            in_flight_.fetch_add(1, std::memory_order_relaxed);  // 先计数再入队，计数不会提前归零
+            TP_TRACE(trace::event::enqueue, 1);
+            const bool in_branch = current_ && current_->owner == this;
+            if(level >= 0) {
+                level_queue& q = *levels_[level];
+                q.size.fetch_add(1, std::memory_order_relaxed);
+                prioritized_.fetch_add(1, std::memory_order_relaxed);
+                q.tasks.push_back(std::move(task));
+            }
+            else if(opts_.work_stealing && in_branch)  // 工作线程内提交，进入本地队列
+                current_->local.push(make_node(std::move(task)));
+            else if(ring_ && !(task.pinned() && drops_oldest())) {  // drop_oldest 只能从 ring 头部丢弃，不可丢弃的任务此时不进入
+                if(!in_branch && full == ring_full::wait)
+                    ring_->push(std::move(task));  // 队列满时阻塞外部提交者，形成背压
+                else if(ring_->try_push(std::move(task)) == push_status::full) {
+                    if(!in_branch && full == ring_full::fail) {
+                        finish_task();
+                        return false;
+                    }
+                    tasks_.push_back(std::move(task));
+                }
+            }
+            else
+                tasks_.push_back(std::move(task));
+            parker_.unpark_one();
+            return true;
+        }
+
+        // 设置了 capacity 时，整批中能一次占到位的部分批量入队，其余逐个按 overflow 策略处理
+        void push_tasks(std::vector<Task>& batch, int level) {
+            if(batch.empty())
+                return;
+            if(level >= 0)
+                check_level(level);
+            if(opts_.capacity > 0) {
+                std::size_t k = reserve(batch.size());
+                std::vector<Task> rest(std::make_move_iterator(batch.begin() + static_cast<std::ptrdiff_t>(k)),
+                                       std::make_move_iterator(batch.end()));
+                batch.resize(k);
+                enqueue_bulk(batch, level);
+                for(auto& task : rest)
+                    push_task(std::move(task), level);
+                return;
+            }
+            enqueue_bulk(batch, level);
+        }
+
+        void enqueue_bulk(std::vector<Task>& batch, int level) {
+            if(batch.empty())
+                return;
+            in_flight_.fetch_add(batch.size(), std::memory_order_relaxed);
+            TP_TRACE(trace::event::enqueue, batch.size());
+            const bool in_branch = current_ && current_->owner == this;
+            if(level >= 0) {
+                level_queue& q = *levels_[level];
+                q.size.fetch_add(batch.size(), std::memory_order_relaxed);
+                prioritized_.fetch_add(batch.size(), std::memory_order_relaxed);
+                q.tasks.push_back_bulk(batch.begin(), batch.end());
+            }
+            else if(opts_.work_stealing && in_branch) {
+                for(auto& task : batch)
+                    current_->local.push(make_node(std::move(task)));
+            }
+            else if(ring_) {
+                if(!in_branch && on_ring_full(true) == ring_full::wait)
+                    ring_->push_bulk(batch.begin(), batch.size());
+                else {  // 整批都已占到位，放不进 ring 的部分溢出，不拒绝其中一部分
+                    auto k = ring_->try_push_bulk(batch.begin(), batch.size());
+                    tasks_.push_back_bulk(batch.begin() + static_cast<std::ptrdiff_t>(k), batch.end());
+                }
+            }
+            else
+                tasks_.push_back_bulk(batch.begin(), batch.end());
+            parker_.unpark(batch.size());
+        }
+
+        void check_level(int level) const {
+            if(static_cast<unsigned>(level) >= opts_.priority_levels)
+                throw std::invalid_argument("workspace: priority level out of range, see branch_options::priority_levels");
+        }
+
+        // help_until 和 wait(fut) 的实现，timed 为真时每次最多休眠 help_sleep
+        template <typename Pred>
+        void help(Pred& pred, bool timed) {
+            unsigned idle = 0;
+            while(!pred()) {
+                if(run_pending_task()) {
+                    idle = 0;
+                    continue;
+                }
+                if(idle < help_spin_rounds) {
+                    ++idle;
+                    if(idle < help_spin_rounds / 2)
+                        cpu_relax();
+                    else
+                        std::this_thread::yield();
+                    continue;
+                }
+                // park 在检查 ready 之前有 seq_cst 栅栏，与 wake_helpers 的栅栏配对，不会错过唤醒
+                num_helpers_.fetch_add(1, std::memory_order_relaxed);
+                auto ready = [&] { return pred() || num_shared_tasks() > 0 || num_local_tasks() > 0; };
+                if(timed)
+                    parker_.park_for(ready, help_sleep);
+                else
+                    parker_.park(ready);
+                num_helpers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        // 任务执行完（包括其中提交的子任务已计数）后调用；计数归零且有人等待时才加锁通知
+        void finish_task() {
+            if(in_flight_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);  // 与 wait_until_quiescent 中的栅栏配对
+                if(num_waiters_.load(std::memory_order_relaxed) > 0) {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    task_done_.notify_all();
+                }
+            }
+        }
+
+        template <typename Wait>
+        bool wait_until_quiescent(Wait&& wait) {
+            if(current_ && current_->owner == this)
+                throw std::runtime_error("workspace: Cannot wait for tasks from a worker of the same branch");
+            num_waiters_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool res;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                res = wait(lock, task_done_, [this] { return in_flight_.load(std::memory_order_acquire) == 0; });
+            }
+            num_waiters_.fetch_sub(1, std::memory_order_relaxed);
+            return res;
+        }
+
+        bool pop_task(worker_ctx* ctx, Task& task) {
+            // 没有优先级任务时只多这一次读
+            bool got = (prioritized_.load(std::memory_order_relaxed) > 0 && pop_prioritized(ctx, task)) || pop_normal(ctx, task);
+            if(got && opts_.capacity > 0)
+                release_slot();
+            return got;
+        }
+
+        // 占用最多 n 个空位，返回占到的个数
+        std::size_t reserve(std::size_t n = 1) {
+            std::size_t cur = queued_.load(std::memory_order_relaxed);
+            while(cur < opts_.capacity) {
+                std::size_t k = std::min(n, opts_.capacity - cur);
+                if(queued_.compare_exchange_weak(cur, cur + k, std::memory_order_relaxed))
+                    return k;
+            }
+            return 0;
+        }
+
+        // 不论是否已满都占一个空位，出队时照常释放
+        void over_admit() {
+            if(opts_.capacity > 0)
+                queued_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 出队后释放空位；有提交者在等待时才加锁通知
+        void release_slot() {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);  // 与 wait_for_space 中的栅栏配对
+            if(num_blocked_.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                space_cv_.notify_one();
+            }
+        }
+
+        // 为 task 占一个空位，已满时按 overflow 策略处理；返回 accepted / dropped_oldest 时由调用者入队
+        submit_status admit(Task& task, bool wait) {
+            if(reserve() > 0)
+                return submit_status::accepted;
+            const bool in_branch = current_ && current_->owner == this;
+            switch(opts_.overflow) {
+                case overflow_policy::block:
+                    if(in_branch) {  // 工作线程等待自己所在的分支可能死锁，超额入队
+                        over_admit();
+                        return submit_status::accepted;
+                    }
+                    if(wait && wait_for_space())
+                        return submit_status::accepted;
+                    break;
+                case overflow_policy::reject:
+                    break;
+                case overflow_policy::caller_runs:
+                    in_flight_.fetch_add(1, std::memory_order_relaxed);
+                    execute(in_branch ? current_ : nullptr, task);
+                    return submit_status::caller_ran;
+                case overflow_policy::drop_oldest: {
+                    Task old;
+                    if(pop_oldest(old)) {  // 新任务接替它的空位
+                        old.reset();
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        finish_task();
+                        return submit_status::dropped_oldest;
+                    }
+                    if(reserve() == 0)  // 排队的都不可丢弃（或已占位的任务还没入队）：这个策略下提交者从不等待，超额入队
+                        over_admit();
+                    return submit_status::accepted;
+                }
+            }
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return submit_status::rejected;
+        }
+
+        // 等到占到一个空位返回 true，分支析构时返回 false
+        bool wait_for_space() {
+            num_blocked_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool reserved = false;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                space_cv_.wait(lock, [&] { return destructing_ || (reserved = reserve() > 0); });
+            }
+            num_blocked_.fetch_sub(1, std::memory_order_relaxed);
+            return reserved;
+        }
+
+        // drop_oldest 的丢弃对象：先找 normal，再从最低优先级往上找，每个队列里取最早入队的可丢弃任务。
+        // 本地队列只能从头部窃取，窃取到的不可丢弃任务转移到共享队列，不会丢失
+        bool pop_oldest(Task& task) {
+            auto droppable = [](const Task& t) { return !t.pinned(); };
+            if(ring_ && ring_->try_pop(task))
+                return true;
+            if(tasks_.try_pop_if(task, droppable))
+                return true;
+            if(opts_.work_stealing) {
+                std::size_t n = num_victims_.load(std::memory_order_acquire);
+                for(std::size_t i = 0; i < n; ++i) {
+                    task_node node = nullptr;
+                    while(victims_[i].load(std::memory_order_acquire)->local.steal(node)) {
+                        take_node(node, task);
+                        if(!task.pinned())
+                            return true;
+                        tasks_.push_back(std::move(task));
+                        parker_.unpark_one();
+                    }
+                }
+            }
+            for(unsigned i = opts_.priority_levels; i-- > 0;) {
+                level_queue& q = *levels_[i];
+                if(q.size.load(std::memory_order_relaxed) == 0 || !q.tasks.try_pop_if(task, droppable))
+                    continue;
+                q.size.fetch_sub(1, std::memory_order_relaxed);
+                prioritized_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        // strict 从第 0 级开始找；weighted 先看轮转表指定的级别（可能是 normal），为空时再从第 0 级开始找
+        bool pop_prioritized(worker_ctx* ctx, Task& task) {
+            unsigned first = 0;
+            if(ctx && !schedule_.empty()) {
+                first = schedule_[ctx->turn++ % schedule_.size()];
+                if(first == opts_.priority_levels) {
+                    if(pop_normal(ctx, task))
+                        return true;
+                    first = 0;
+                }
+                else if(pop_level(first, task))
+                    return true;
+            }
+            for(unsigned i = 0; i < opts_.priority_levels; ++i) {
+                if(pop_level(i, task))
+                    return true;
+            }
+            return false;
+        }
+
+        bool pop_level(unsigned i, Task& task) {
+            level_queue& q = *levels_[i];
+            if(q.size.load(std::memory_order_relaxed) == 0 || !q.tasks.try_pop(task))
+                return false;
+            q.size.fetch_sub(1, std::memory_order_relaxed);
+            prioritized_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool pop_normal(worker_ctx* ctx, Task& task) {
+            if(!opts_.work_stealing && !ring_)
+                return tasks_.try_pop(task);
+            // 周期性地先看互斥队列，防止其中溢出的任务被饿死
+            if(ctx && ++ctx->ticks % global_check_interval == 0 && tasks_.try_pop(task))
+                return true;
+            task_node node = nullptr;
+            if(opts_.work_stealing && ctx && ctx->local.pop(node))
+                return take_node(node, task);
+            if(ring_ && ring_->try_pop(task))
+                return true;
+            if(tasks_.try_pop(task))
+                return true;
+            return opts_.work_stealing && steal_task(ctx, task);
+        }
+
+        // 平滑加权轮转：权重为 w 的级别在长度为 Σw 的表中出现 w 次，且尽量均匀分散
+        std::vector<unsigned> make_schedule() const {
+            const unsigned n = opts_.priority_levels + 1;
+            std::vector<unsigned> weights = opts_.priority_weights;
+            if(weights.empty()) {
+                for(unsigned i = 0; i < n; ++i)
+                    weights.push_back(1u << std::min(n - 1 - i, 10u));
+            }
+            if(weights.size() != n)
+                throw std::invalid_argument("workspace: priority_weights needs priority_levels + 1 entries");
+            std::size_t total = 0;
+            for(unsigned w : weights) {
+                if(w == 0)
+                    throw std::invalid_argument("workspace: priority weights must be positive");
+                total += w;
+            }
+            if(total > max_schedule_length)
+                throw std::invalid_argument("workspace: priority weights are too large");
+            std::vector<unsigned> table;
+            std::vector<long long> current(n, 0);
+            for(std::size_t k = 0; k < total; ++k) {
+                unsigned best = 0;
+                for(unsigned i = 0; i < n; ++i) {
+                    current[i] += weights[i];
+                    if(current[i] > current[best])
+                        best = i;
+                }
+                current[best] -= static_cast<long long>(total);
+                table.push_back(best);
+            }
+            return table;
+        }
+
+        bool steal_task(worker_ctx* self, Task& task) {
+            std::size_t n = num_victims_.load(std::memory_order_acquire);
+            if(n == 0)
+                return false;
+            std::size_t start = 0;
+            if(self) {  // xorshift64
+                self->metrics.steal_attempts.add();
+                self->seed ^= self->seed << 13;
+                self->seed ^= self->seed >> 7;
+                self->seed ^= self->seed << 17;
+                start = static_cast<std::size_t>(self->seed % n);
+            }
+            for(std::size_t i = 0; i < n; ++i) {
+                worker_ctx* victim = victims_[(start + i) % n].load(std::memory_order_acquire);
+                task_node node = nullptr;
+                if(victim != self && victim->local.steal(node)) {
+                    TP_TRACE(trace::event::steal, (start + i) % n);
+                    if(self)
+                        self->metrics.steals.add();
+                    return take_node(node, task);
                 }
-            };
+            }
+            return false;
+        }
+
+        // 工作窃取队列中的任务节点从 mr_ 分配，由取走它的线程释放
+        task_node make_node(Task&& task) {
+            return ::new(mr_->allocate(sizeof(Task), alignof(Task))) Task(std::move(task));
+        }
+
+        void free_node(task_node node) {
+            node->~Task();
+            mr_->deallocate(node, sizeof(Task), alignof(Task));
+        }
+
+        bool take_node(task_node node, Task& task) {
+            task = std::move(*node);
+            free_node(node);
+            return true;
+        }
+
+        std::size_t num_shared_tasks() const {
+            return tasks_.size() + (ring_ ? ring_->size() : 0) + prioritized_.load(std::memory_order_relaxed);
+        }
+
+        std::size_t num_local_tasks() const {
+            std::size_t n = 0;
+            if(opts_.work_stealing) {
+                std::size_t vs = num_victims_.load(std::memory_order_acquire);
+                for(std::size_t i = 0; i < vs; ++i)
+                    n += victims_[i].load(std::memory_order_acquire)->local.size();
+            }
+            return n;
+        }
+
+        // 为当前线程取得一个空闲的上下文，超过上限时退化为只用共享队列
+        worker_ctx* attach_ctx() {
+            std::lock_guard<std::mutex> lock(mtx_);
+            worker_ctx* ctx = nullptr;
+            for(auto& each : ctx_pool_) {
+                if(!each->active.load(std::memory_order_relaxed)) {
+                    ctx = each.get();
+                    break;
+                }
+            }
+            if(!ctx) {
+                if(ctx_pool_.size() >= max_ctx_workers)
+                    return nullptr;
+                ctx_pool_.emplace_back(std::make_unique<worker_ctx>());
+                ctx = ctx_pool_.back().get();
+                ctx->owner = this;
+                ctx->seed = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+                victims_[ctx_pool_.size() - 1].store(ctx, std::memory_order_release);
+                num_victims_.store(ctx_pool_.size(), std::memory_order_release);
+            }
+            ctx->active.store(true, std::memory_order_relaxed);
+            ctx->metrics.attach(opts_.collect_timing);
+            current_ = ctx;
+            return ctx;
+        }
+
+        // 线程退出前把本地剩余任务转移到共享队列；调用者持有 mtx_
+        void detach_ctx(worker_ctx* ctx) {
+            task_node node = nullptr;
+            bool moved = false;
+            while(ctx->local.pop(node)) {
+                tasks_.push_back(std::move(*node));
+                free_node(node);
+                moved = true;
+            }
+            ctx->metrics.detach();
+            ctx->active.store(false, std::memory_order_release);
+            current_ = nullptr;
+            if(moved)
+                parker_.unpark_all();
+        }
+
+        // 捕获较大、放不进 Task 内部的任务从分支的内存资源分配
+        template <typename F>
+        Task make_task_wrapper(F &&task) const {
+            if(opts_.collect_timing) {
+                return Task(std::allocator_arg, mr_, [task = std::forward<F>(task), queued_at = detail::now_ns()]() mutable {
+                    std::uint64_t start = detail::now_ns();
+                    detail::metrics_block* m = detail::current_metrics;
+                    if(m)
+                        m->record_wait(start - queued_at);
+                    invoke_guarded(task);
+                    if(m)
+                        m->busy_ns.add(detail::now_ns() - start);
+                });
+            }
+            return Task(std::allocator_arg, mr_, [task = std::forward<F>(task)]() mutable { invoke_guarded(task); });
+        }
+
+        template <typename Future>
+        static bool future_ready(const Future& fut) {
+            if constexpr (has_is_ready<Future>::value)
+                return fut.is_ready();
+            else
+                return fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        template <typename Future, typename = void>
+        struct has_is_ready : std::false_type {};
+        template <typename Future>
+        struct has_is_ready<Future, std::void_t<decltype(std::declval<const Future&>().is_ready())>> : std::true_type {};
+
+        template <typename R>
+        std::promise<R> make_promise() const {
+            return std::promise<R>(std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>(mr_));
+        }
+
+        // 执行 fn，把结果或异常交给 done
+        template <typename R, typename F>
+        static void fulfil(std::promise<R>& done, F&& fn) {
+            try {
+                if constexpr (std::is_void_v<R>) {
+                    fn();
+                    done.set_value();
+                } else
+                    done.set_value(fn());
+            } catch (...) {
+                done.set_exception(std::current_exception());
+            }
+        }
+
+        template <typename F>
+        static void invoke_guarded(F& task) {
+            try {
+                task();
+            } catch (...) {
+                count_exception();
+                if(WorkBranch* br = executing_)
+                    br->report_error(std::current_exception());
+            }
+        }
+
+        static void count_exception() {
+            if(auto* c = detail::current_exceptions)
+                c->fetch_add(1, std::memory_order_relaxed);
         }
 
         template <typename F>
@@ -0,0 +1,129 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace tp {
+
+    // Chase-Lev 无锁双端队列 (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+    // 只有拥有者线程可以 push/pop（从底部，LIFO），其他线程只能 steal（从顶部，FIFO）
+    // T 需要是可平凡复制的类型，一般存放任务节点指针
+    template <typename T>
+    class WorkStealingDeque {
+        static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque stores trivially copyable values");
+
+        struct Array {
+            const std::int64_t cap;
+            const std::int64_t mask;
+            std::unique_ptr<std::atomic<T>[]> buf;
+
+            explicit Array(std::int64_t c) : cap(c), mask(c - 1), buf(new std::atomic<T>[c]) {}
+
+            T get(std::int64_t i) const noexcept {
+                return buf[i & mask].load(std::memory_order_acquire);
+            }
+
+            void put(std::int64_t i, T v) noexcept {
+                buf[i & mask].store(v, std::memory_order_release);
+            }
+
+            Array* grow(std::int64_t b, std::int64_t t) const {
+                auto* a = new Array(cap * 2);
+                for(std::int64_t i = t; i < b; ++i)
+                    a->put(i, get(i));
+                return a;
+            }
+        };
+
+        alignas(64) std::atomic<std::int64_t> top_{0};
+        alignas(64) std::atomic<std::int64_t> bottom_{0};
+        alignas(64) std::atomic<Array*> array_;
+        std::vector<std::unique_ptr<Array>> retired_;  // 扩容后的旧数组，窃取者可能仍在读取，析构时再释放
+
+    public:
+        explicit WorkStealingDeque(std::int64_t capacity = 256) {
+            std::int64_t cap = 1;
+            while(cap < capacity)
+                cap <<= 1;
+            array_.store(new Array(cap), std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+        ~WorkStealingDeque() {
+            delete array_.load(std::memory_order_relaxed);
+        }
+
+        // 仅拥有者调用
+        void push(T v) {
+            std::int64_t b = bottom_.load(std::memory_order_relaxed);
+            std::int64_t t = top_.load(std::memory_order_acquire);
+            Array* a = array_.load(std::memory_order_relaxed);
+            if(b - t > a->cap - 1) {
+                retired_.emplace_back(a);
+                a = a->grow(b, t);
+                array_.store(a, std::memory_order_release);
+            }
+            a->put(b, v);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        // 仅拥有者调用
+        bool pop(T& out) {
+            std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            Array* a = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = top_.load(std::memory_order_relaxed);
+            if(t > b) {  // 队列为空
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            out = a->get(b);
+            if(t == b) {  // 只剩最后一个元素，和窃取者竞争
+                bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // 任意线程调用，竞争失败时返回 false
+        bool steal(T& out) {
+            std::int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t b = bottom_.load(std::memory_order_acquire);
+            if(t >= b)
+                return false;
+            Array* a = array_.load(std::memory_order_acquire);
+            T v = a->get(t);
+            if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return false;
+            out = v;
+            return true;
+        }
+
+        // 近似值，仅用于统计和休眠前的检查
+        [[nodiscard]] std::size_t size() const noexcept {
+            std::int64_t b = bottom_.load(std::memory_order_relaxed);
+            std::int64_t t = top_.load(std::memory_order_relaxed);
+            return b > t ? static_cast<std::size_t>(b - t) : 0;
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+    };
+
+}
+
+#endif //WORKSTEALINGDEQUE_H
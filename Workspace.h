@@ -4,11 +4,22 @@
 
 #ifndef WORKSPACE_H
 #define WORKSPACE_H
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include "Supervisor.h"
+#include "Topology.h"
 #include "WorkBranch.h"
 
 namespace tp {
@@ -50,46 +61,110 @@ namespace tp {
     private:
         using branch_lst = std::list<std::unique_ptr<WorkBranch>>;
         using superv_map = std::map<const Supervisor*, std::unique_ptr<Supervisor>>;
-        using pos_t = branch_lst::iterator;
 
-        pos_t cur_ {};
-        branch_lst branches_;
-        superv_map supervs_;
+        // 提交路径读取的分支快照，attach/detach 时整体替换（写时复制），提交不需要加锁
+        struct view {
+            std::vector<WorkBranch*> branches;
+            std::size_t numa_branches = 0;  // 绑定了 NUMA 节点的分支数，非 0 时按节点路由
+        };
+
+        struct alignas(64) reader_count {
+            std::atomic<std::size_t> n{0};
+        };
+
+        // 持有期间快照不会被释放。读者按进入时的纪元奇偶计数，写者发布新快照并翻转纪元后，
+        // 只需等旧纪元的读者全部离开就可以释放旧快照
+        class read_guard {
+            const Workspace& ws_;
+            std::size_t slot_ = 0;
+            const view* v_ = nullptr;
+        public:
+            explicit read_guard(const Workspace& ws) : ws_(ws) {
+                while(true) {
+                    std::size_t e = ws_.epoch_.load();
+                    ws_.readers_[e & 1].n.fetch_add(1);
+                    if(ws_.epoch_.load() == e) {
+                        slot_ = e & 1;
+                        v_ = ws_.view_.load();
+                        return;
+                    }
+                    ws_.readers_[e & 1].n.fetch_sub(1, std::memory_order_release);
+                }
+            }
+            ~read_guard() { ws_.readers_[slot_].n.fetch_sub(1, std::memory_order_release); }
+            read_guard(const read_guard&) = delete;
+            read_guard& operator=(const read_guard&) = delete;
+            const view& operator*() const { return *v_; }
+            const view* operator->() const { return v_; }
+        };
+
+        branch_lst branches_;   // 由 mtx_ 保护，持有分支
+        superv_map supervs_;    // 由 mtx_ 保护
+        std::unique_ptr<view> owned_view_ = std::make_unique<view>();  // 当前快照，由 mtx_ 保护
+        std::atomic<const view*> view_{owned_view_.get()};
+        std::atomic<std::size_t> epoch_{0};
+        mutable reader_count readers_[2];
+        std::atomic<std::size_t> spill_factor_{2};  // 本节点在途任务超过 线程数 * spill_factor_ 时溢出到其他节点
+        std::mutex mtx_;
     public:
         explicit Workspace() = default;
         ~Workspace() {
+            supervs_.clear();  // 先停下 Supervisor，它们还引用着分支
             branches_.clear();
-            supervs_.clear();
         }
         Workspace(const Workspace&) = delete;
         Workspace& operator=(const Workspace&) = delete;
 
     public:
+        // attach/detach 可以与 submit 并发调用
         Bid attach(WorkBranch* br) {
-            static_assert(br != nullptr);
+            if(br == nullptr)
+                throw std::invalid_argument("workspace: Cannot attach a null branch");
+            std::lock_guard<std::mutex> lock(mtx_);
             branches_.emplace_back(br);
+            publish();
             return Bid{br};
         }
 
+        // 每个 NUMA 节点创建一个绑定到该节点的分支，之后的 submit 优先进入调用线程所在节点的分支
+        std::vector<Bid> attach_per_node(int workers_per_node, branch_options opts = {}) {
+            std::vector<Bid> ids;
+            for(int node = 0; node < topology::num_nodes(); ++node) {
+                opts.numa_node = node;
+                opts.cpu_affinity.clear();
+                ids.push_back(attach(new WorkBranch(workers_per_node, opts)));
+            }
+            return ids;
+        }
+
+        void set_spill_factor(std::size_t factor) {
+            spill_factor_.store(factor, std::memory_order_relaxed);
+        }
+
         Sid attach(Supervisor* sp) {
-            static_assert(sp != nullptr);
+            if(sp == nullptr)
+                throw std::invalid_argument("workspace: Cannot attach a null supervisor");
+            std::lock_guard<std::mutex> lock(mtx_);
             supervs_.emplace(sp, sp);
             return Sid{sp};
         }
 
+        // 等正在使用旧快照的提交结束后才交出分支，返回后调用者可以安全地销毁它
         auto detach(Bid id) -> std::unique_ptr<WorkBranch> {
+            std::lock_guard<std::mutex> lock(mtx_);
             for (auto it = branches_.begin(); it!=branches_.end();++it) {
                 if(it->get() == id.base) {
-                    if (cur_ == it) forward(cur_);
-                    auto ptr = it->release();
+                    auto ptr = std::move(*it);
                     branches_.erase(it);
-                    return std::unique_ptr<WorkBranch>(ptr);
+                    publish();
+                    return ptr;
                 }
             }
             return nullptr;
         }
 
         auto detach(Sid id) -> std::unique_ptr<Supervisor> {
+            std::lock_guard<std::mutex> lock(mtx_);
             auto it = supervs_.find(id.base);
             if(it == supervs_.end())
                 return nullptr;
@@ -99,12 +174,15 @@ namespace tp {
             return std::unique_ptr<Supervisor>(ptr);
         }
 
+        // 遍历调用时的分支快照；deal 中不能 detach 分支，否则会一直等待这次遍历结束
         void for_each(const std::function<void(WorkBranch&)>& deal) {
-            for(auto &branch:branches_)
+            read_guard v(*this);
+            for(auto* branch : v->branches)
                 deal(*branch);
         }
 
         void for_each(const std::function<void(Supervisor&)>& deal) {
+            std::lock_guard<std::mutex> lock(mtx_);
             for(auto & [id, each] : supervs_)
                 deal(*each);
         }
@@ -132,14 +210,8 @@ namespace tp {
             typename DR = std::enable_if_t<std::is_void_v<R>>
         >
         void submit(F&& task) {
-            static_assert(!branches_.empty());
-            auto this_br = cur_->get();
-            auto next_br = forward(cur_)->get();    // TODO: 有bug需要修复
-            if(next_br->num_tasks() < this_br->num_tasks()) {
-                next_br->submit<T>(std::forward<F>(task));
-            }
-            else
-                this_br->submit<T>(std::forward<F>(task));
+            read_guard v(*this);
+            pick(*v)->submit<T>(std::forward<F>(task));
         }
 
         template<
@@ -149,29 +221,166 @@ namespace tp {
             typename DR = std::enable_if_t<!std::is_void_v<R>>
         >
         auto submit(F&& task) -> std::future<R> {
-            static_assert(!branches_.empty());
-            auto this_br = cur_->get();
-            auto next_br = forward(cur_)->get();
-            if(next_br->num_tasks() < this_br->num_tasks())
-                return next_br->submit<T>(std::forward<F>(task));
-            return this_br->submit<T>(std::forward<F>(task));
+            read_guard v(*this);
+            return pick(*v)->submit<T>(std::forward<F>(task));
         }
 
         template<typename T, typename F, typename ...Fs>
-        void submit(F&& task, Fs&& ...funcs) -> std::enable_if_t<std::is_same_v<T, sequence>> {
-            static_assert(!branches_.empty());
-            auto this_br = cur_->get();
-            auto next_br = forward(cur_)->get();
-            if(next_br->num_tasks() < this_br->num_tasks())
-                return next_br->submit<T>(std::forward<F>(task), std::forward<Fs>(funcs)...);
-            return this_br->submit<T>(std::forward<F>(task), std::forward<Fs>(funcs)...);
+        auto submit(F&& task, Fs&& ...funcs) -> std::enable_if_t<std::is_same_v<T, sequence>> {
+            read_guard v(*this);
+            return pick(*v)->submit<T>(std::forward<F>(task), std::forward<Fs>(funcs)...);
+        }
+
+        // 见 WorkBranch::try_submit，只尝试选中的那一个分支
+        template <typename T = normal, typename F>
+        submit_status try_submit(F&& task) {
+            read_guard v(*this);
+            return pick(*v)->try_submit<T>(std::forward<F>(task));
+        }
+
+        // 见 WorkBranch::submit_cancellable
+        template <typename T = normal, typename F>
+        auto submit_cancellable(F&& task) {
+            read_guard v(*this);
+            return pick(*v)->submit_cancellable<T>(std::forward<F>(task));
+        }
+
+        // 相同 key 的任务总是进入同一个分支（rendezvous 哈希），attach/detach 只会让落在变动分支上的 key 改变去向
+        // 返回值与 WorkBranch::submit<T> 相同
+        template <typename T = normal, typename F>
+        auto submit_affine(std::size_t key, F&& task) {
+            read_guard v(*this);
+            if(v->branches.empty())
+                throw std::runtime_error("workspace: No branch to submit to");
+            WorkBranch* best = nullptr;
+            std::uint64_t best_score = 0;
+            for(auto* br : v->branches) {
+                std::uint64_t score = mix(key ^ mix(reinterpret_cast<std::uintptr_t>(br)));
+                if(!best || score > best_score) {
+                    best = br;
+                    best_score = score;
+                }
+            }
+            return best->submit<T>(std::forward<F>(task));
+        }
+
+        // 批量提交：按分支数均分成连续的几段，每个分支只加一次锁
+        template <typename T = normal, typename It>
+        auto submit_bulk(It first, It last) {
+            return scatter<T>(first, last, [](WorkBranch& br, It b, It e) {
+                return br.submit_bulk<T>(b, e);
+            });
+        }
+
+        template <
+            typename T = normal,
+            typename Range,
+            typename F,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<Range>, std::decay_t<F>>>
+        >
+        auto submit_bulk(Range&& range, F&& fn) {
+            using It = decltype(std::begin(range));
+            return scatter<T>(std::begin(range), std::end(range), [&fn](WorkBranch& br, It b, It e) {
+                struct slice { It b, e; It begin() const {return b;} It end() const {return e;} };
+                return br.submit_bulk<T>(slice{b, e}, fn);
+            });
         }
 
     private:
-        const pos_t& forward(pos_t& this_pos) {
-            if(++this_pos == branches_.end())
-                this_pos = branches_.end();
-            return this_pos;
+        // 由 branches_ 重建快照并发布，等旧快照的读者离开后释放它；调用者持有 mtx_
+        void publish() {
+            auto next = std::make_unique<view>();
+            for(auto& br : branches_) {
+                next->branches.push_back(br.get());
+                if(br->numa_node() >= 0)
+                    ++next->numa_branches;
+            }
+            view_.store(next.get());
+            std::size_t e = epoch_.load(std::memory_order_relaxed);
+            epoch_.store(e + 1);
+            while(readers_[e & 1].n.load(std::memory_order_acquire) > 0)
+                std::this_thread::yield();
+            owned_view_ = std::move(next);
+        }
+
+        // 选择接收任务的分支：随机取两个分支，选每个线程平均在途任务较少的一个（power of two choices）
+        // 在途任务数和线程数都是原子计数，不加分支的锁
+        WorkBranch* pick(const view& v) const {
+            const std::size_t n = v.branches.size();
+            if(n == 0)
+                throw std::runtime_error("workspace: No branch to submit to");
+            if(n == 1)
+                return v.branches.front();
+            if(v.numa_branches > 0) {
+                if(WorkBranch* local = pick_local(v))
+                    return local;
+            }
+            std::uint64_t r = next_random();
+            std::size_t i = static_cast<std::size_t>(r % n);
+            std::size_t j = static_cast<std::size_t>((r >> 32) % (n - 1));
+            if(j >= i)
+                ++j;
+            WorkBranch* a = v.branches[i];
+            WorkBranch* b = v.branches[j];
+            std::size_t wa = std::max<std::size_t>(a->num_workers(), 1);
+            std::size_t wb = std::max<std::size_t>(b->num_workers(), 1);
+            return a->num_in_flight() * wb <= b->num_in_flight() * wa ? a : b;
+        }
+
+        // 调用线程所在节点的分支，未饱和时返回它，否则返回空指针，由调用者在所有分支中选择
+        WorkBranch* pick_local(const view& v) const {
+            const int node = topology::current_node();
+            for(auto* br : v.branches) {
+                if(br->numa_node() == node) {
+                    if(br->num_in_flight() <= br->num_workers() * spill_factor_.load(std::memory_order_relaxed))
+                        return br;
+                    return nullptr;
+                }
+            }
+            return nullptr;
+        }
+
+        static std::uint64_t next_random() {
+            static thread_local std::uint64_t seed = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+            seed ^= seed << 13;  // xorshift64
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            return seed;
+        }
+
+        static std::uint64_t mix(std::uint64_t x) {  // splitmix64 的终结函数
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+
+        template <typename T, typename It, typename Deal>
+        auto scatter(It first, It last, Deal&& deal) {
+            read_guard v(*this);
+            if(v->branches.empty())
+                throw std::runtime_error("workspace: No branch to submit to");
+            using R = decltype(deal(std::declval<WorkBranch&>(), first, last));
+            auto total = static_cast<std::size_t>(std::distance(first, last));
+            std::size_t n = v->branches.size();
+            std::size_t i = 0;
+            [[maybe_unused]] std::conditional_t<std::is_void_v<R>, int, R> all{};
+            for(auto* br : v->branches) {
+                auto cnt = total / n + (i++ < total % n ? 1 : 0);
+                if(cnt == 0)
+                    break;
+                It mid = std::next(first, static_cast<std::ptrdiff_t>(cnt));
+                if constexpr (std::is_void_v<R>)
+                    deal(*br, first, mid);
+                else
+                    for(auto& f : deal(*br, first, mid))
+                        all.add_back(std::move(f));
+                first = mid;
+            }
+            if constexpr (!std::is_void_v<R>)
+                return all;
         }
     };
 }
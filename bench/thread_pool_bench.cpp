@@ -0,0 +1,626 @@
+//
+// Created by blair on 2026/10/17.
+//
+
+// 基准测试套件，参数风格与 Google Benchmark 一致：
+//   --benchmark_filter=<regex>      只运行名称匹配的项
+//   --benchmark_format=console|json 标准输出的格式
+//   --benchmark_out=<file>          另外把 JSON 结果写入文件
+// JSON 结构与 Google Benchmark 相同（context + benchmarks），可以直接导入同样的看板
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <regex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Future.h"
+#include "Parallel.h"
+#include "Strand.h"
+#include "TaskGroup.h"
+#include "WorkBranch.h"
+#include "Workspace.h"
+
+using namespace tp;
+using bench_clock = std::chrono::steady_clock;
+
+// 统计全局 operator new 的调用次数，用于 alloc/* 基准
+static std::atomic<std::uint64_t> g_allocations{0};
+
+void* operator new(std::size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t n, std::align_val_t al) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = static_cast<std::size_t>(al);
+    if(void* p = std::aligned_alloc(a, (std::max<std::size_t>(n, 1) + a - 1) / a * a))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+    struct bench_result {
+        std::string name;
+        std::size_t iterations = 0;
+        double real_time = 0;  // 每次迭代的纳秒数
+        std::vector<std::pair<std::string, double>> counters;
+    };
+
+    class bench_runner {
+        std::regex filter_{".*"};
+        bool json_ = false;
+        std::string out_;
+        std::vector<bench_result> results_;
+
+    public:
+        bench_runner(int argc, char** argv) {
+            for(int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                auto value = [&](const char* flag) -> const char* {
+                    std::size_t len = std::char_traits<char>::length(flag);
+                    return arg.compare(0, len, flag) == 0 ? arg.c_str() + len : nullptr;
+                };
+                if(const char* v = value("--benchmark_filter="))
+                    filter_ = std::regex(v);
+                else if(const char* v = value("--benchmark_format="))
+                    json_ = std::string(v) == "json";
+                else if(const char* v = value("--benchmark_out="))
+                    out_ = v;
+                else {
+                    std::fprintf(stderr, "unknown argument: %s\n", arg.c_str());
+                    std::exit(1);
+                }
+            }
+        }
+
+        bool enabled(const std::string& name) const {
+            return std::regex_search(name, filter_);
+        }
+
+        void report(bench_result r) {
+            if(!json_) {
+                std::printf("%-56s %14.1f ns %10zu", r.name.c_str(), r.real_time, r.iterations);
+                for(auto& c : r.counters)
+                    std::printf("  %s=%.4g", c.first.c_str(), c.second);
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+            results_.push_back(std::move(r));
+        }
+
+        void finish() const {
+            if(json_)
+                write_json(std::cout);
+            if(!out_.empty()) {
+                std::ofstream out(out_);
+                write_json(out);
+            }
+        }
+
+    private:
+        void write_json(std::ostream& os) const {
+            char date[64];
+            std::time_t now = std::time(nullptr);
+            std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+            os << "{\n  \"context\": {\n"
+               << "    \"date\": \"" << date << "\",\n"
+               << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+               << "    \"library_build_type\": \"release\"\n"
+#else
+               << "    \"library_build_type\": \"debug\"\n"
+#endif
+               << "  },\n  \"benchmarks\": [";
+            for(std::size_t i = 0; i < results_.size(); ++i) {
+                const bench_result& r = results_[i];
+                os << (i ? ",\n" : "\n") << "    {\n"
+                   << "      \"name\": \"" << r.name << "\",\n"
+                   << "      \"run_type\": \"iteration\",\n"
+                   << "      \"iterations\": " << r.iterations << ",\n"
+                   << "      \"real_time\": " << r.real_time << ",\n"
+                   << "      \"time_unit\": \"ns\"";
+                for(auto& c : r.counters)
+                    os << ",\n      \"" << c.first << "\": " << c.second;
+                os << "\n    }";
+            }
+            os << "\n  ]\n}\n";
+        }
+    };
+
+    double ns_per(bench_clock::duration d, std::size_t n) {
+        return std::chrono::duration<double, std::nano>(d).count() / static_cast<double>(n);
+    }
+
+    double items_per_second(bench_clock::duration d, std::size_t n) {
+        return static_cast<double>(n) / std::chrono::duration<double>(d).count();
+    }
+
+    void wait_until(const std::atomic<std::size_t>& done, std::size_t n) {
+        while(done.load(std::memory_order_acquire) < n)
+            std::this_thread::yield();
+    }
+
+    // 百分位数，samples 会被排序
+    std::vector<std::pair<std::string, double>> percentiles(std::vector<double>& samples) {
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return samples[static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1))]; };
+        return {{"p50_ns", at(0.50)}, {"p90_ns", at(0.90)}, {"p99_ns", at(0.99)}, {"p999_ns", at(0.999)}, {"max_ns", samples.back()}};
+    }
+
+    // 入队吞吐：逐个 submit、submit_bulk、std::async 与单线程直接调用
+    void bench_enqueue(bench_runner& r, int workers, std::size_t n, std::size_t batch_size) {
+        std::atomic<std::size_t> done{0};
+        auto task = [&done] { done.fetch_add(1, std::memory_order_relaxed); };
+        std::string suffix = "/workers:" + std::to_string(workers);
+
+        if(workers == 1 && r.enabled("enqueue/single_thread")) {
+            std::vector<std::function<void()>> fns(n, task);
+            auto t0 = bench_clock::now();
+            for(auto& fn : fns)
+                fn();
+            auto t1 = bench_clock::now();
+            r.report({"enqueue/single_thread", n, ns_per(t1 - t0, n), {{"items_per_second", items_per_second(t1 - t0, n)}}});
+        }
+        if(r.enabled("enqueue/tp_submit" + suffix)) {
+            done = 0;
+            WorkBranch br(workers);
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < n; ++i)
+                br.submit(task);
+            auto t1 = bench_clock::now();
+            wait_until(done, n);
+            auto t2 = bench_clock::now();
+            r.report({"enqueue/tp_submit" + suffix, n, ns_per(t2 - t0, n),
+                      {{"enqueue_ns", ns_per(t1 - t0, n)}, {"items_per_second", items_per_second(t2 - t0, n)}}});
+        }
+        if(r.enabled("enqueue/tp_submit_bulk" + suffix)) {
+            done = 0;
+            WorkBranch br(workers);
+            std::vector<decltype(task)> batch(batch_size, task);
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < n; i += batch_size)
+                br.submit_bulk(batch.begin(), batch.end());
+            auto t1 = bench_clock::now();
+            wait_until(done, n);
+            auto t2 = bench_clock::now();
+            r.report({"enqueue/tp_submit_bulk" + suffix, n, ns_per(t2 - t0, n),
+                      {{"batch", static_cast<double>(batch_size)}, {"enqueue_ns", ns_per(t1 - t0, n)},
+                       {"items_per_second", items_per_second(t2 - t0, n)}}});
+        }
+        if(workers == 1 && r.enabled("enqueue/std_async")) {
+            // std::async 每个任务一个线程，数量取小一些
+            std::size_t m = std::min<std::size_t>(n, 2000);
+            done = 0;
+            std::vector<std::future<void>> futs;
+            futs.reserve(m);
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < m; ++i)
+                futs.push_back(std::async(std::launch::async, task));
+            for(auto& f : futs)
+                f.get();
+            auto t1 = bench_clock::now();
+            r.report({"enqueue/std_async", m, ns_per(t1 - t0, m), {{"items_per_second", items_per_second(t1 - t0, m)}}});
+        }
+    }
+
+    // 空任务的总开销：提交到执行完毕（wait_tasks 返回）平均到每个任务
+    void bench_empty_task(bench_runner& r, int workers, std::size_t n) {
+        std::string name = "empty_task/tp_submit/workers:" + std::to_string(workers);
+        if(!r.enabled(name))
+            return;
+        WorkBranch br(workers);
+        auto t0 = bench_clock::now();
+        for(std::size_t i = 0; i < n; ++i)
+            br.submit([] {});
+        br.wait_tasks();
+        auto t1 = bench_clock::now();
+        r.report({name, n, ns_per(t1 - t0, n), {{"items_per_second", items_per_second(t1 - t0, n)}}});
+    }
+
+    // 提交到拿到结果的往返延迟分布
+    void bench_round_trip(bench_runner& r, int workers, std::size_t n) {
+        std::string suffix = "/workers:" + std::to_string(workers);
+        auto run = [&](const std::string& name, auto&& once) {
+            if(!r.enabled(name))
+                return;
+            std::vector<double> samples;
+            samples.reserve(n);
+            auto start = bench_clock::now();
+            for(std::size_t i = 0; i < n; ++i) {
+                auto t0 = bench_clock::now();
+                once();
+                samples.push_back(ns_per(bench_clock::now() - t0, 1));
+            }
+            double mean = ns_per(bench_clock::now() - start, n);
+            r.report({name, n, mean, percentiles(samples)});
+        };
+
+        WorkBranch br(workers);
+        run("round_trip/tp_submit_future" + suffix, [&] { br.submit([] { return 1; }).get(); });
+        run("round_trip/tp_async" + suffix, [&] { tp::async(br, [] { return 1; }).get(); });
+        if(workers == 1)
+            run("round_trip/std_async", [] { std::async(std::launch::async, [] { return 1; }).get(); });
+    }
+
+    // 扇出/扇入：每轮提交 width 个任务并等待全部完成
+    void bench_fan_out_in(bench_runner& r, int workers, std::size_t rounds, std::size_t width) {
+        std::string suffix = "/workers:" + std::to_string(workers) + "/width:" + std::to_string(width);
+        std::atomic<std::size_t> sink{0};
+        auto leaf = [&sink] { sink.fetch_add(1, std::memory_order_relaxed); return 1; };
+        auto run = [&](const std::string& name, auto&& round) {
+            if(!r.enabled(name))
+                return;
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < rounds; ++i)
+                round();
+            auto t1 = bench_clock::now();
+            r.report({name, rounds, ns_per(t1 - t0, rounds), {{"ns_per_task", ns_per(t1 - t0, rounds * width)}}});
+        };
+
+        if(workers == 1)
+            run("fan_out_in/single_thread/width:" + std::to_string(width), [&] {
+                for(std::size_t i = 0; i < width; ++i)
+                    leaf();
+            });
+        WorkBranch br(workers);
+        run("fan_out_in/tp_task_group" + suffix, [&] {
+            TaskGroup group(br);
+            for(std::size_t i = 0; i < width; ++i)
+                group.submit(leaf);
+            group.wait();
+        });
+        run("fan_out_in/tp_futures" + suffix, [&] {
+            futures<int> futs;
+            for(std::size_t i = 0; i < width; ++i)
+                futs.add_back(br.submit(leaf));
+            futs.wait();
+        });
+        run("fan_out_in/tp_when_all" + suffix, [&] {
+            std::vector<tp::future<int>> futs;
+            futs.reserve(width);
+            for(std::size_t i = 0; i < width; ++i)
+                futs.push_back(tp::async(br, leaf));
+            when_all(std::move(futs)).get();
+        });
+        if(workers == 1)
+            run("fan_out_in/std_async/width:" + std::to_string(width), [&] {
+                std::vector<std::future<int>> futs;
+                futs.reserve(width);
+                for(std::size_t i = 0; i < width; ++i)
+                    futs.push_back(std::async(std::launch::async, leaf));
+                for(auto& f : futs)
+                    f.get();
+            });
+    }
+
+    // urgent 与 normal 的入队代价，以及插队效果：唯一的工作线程被占住时入队 n 个任务和 1 个紧急任务，
+    // 记录紧急任务实际执行的位置（0 表示最先执行；n 个任务也是 urgent 时同级先进先出，位置为 n）
+    // levels:4 把 n 个任务轮流提交到 priority<0> ~ priority<3>，对比多级队列的入队和取任务代价
+    void bench_urgent_vs_normal(bench_runner& r, std::size_t n) {
+        for(int mode : {0, 1, 2}) {
+            const bool urgent_first = mode == 1;
+            std::string name = mode == 0 ? "priority/tp_submit_normal" : mode == 1 ? "priority/tp_submit_urgent" : "priority/tp_submit_levels:4";
+            if(!r.enabled(name))
+                continue;
+            branch_options opts;
+            opts.idle = idle_strategy::park;
+            opts.priority_levels = 4;
+            WorkBranch br(1, opts);
+            std::atomic<bool> started{false}, gate{false};
+            std::atomic<std::size_t> order{0};
+            std::size_t urgent_pos = 0;
+            br.submit([&started, &gate] {
+                started.store(true, std::memory_order_release);
+                while(!gate.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+            });
+            while(!started.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            auto normal_task = [&order] { order.fetch_add(1, std::memory_order_relaxed); };
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < n; ++i) {
+                if(mode == 2) {
+                    switch(i & 3) {
+                        case 0: br.submit<priority<0>>(normal_task); break;
+                        case 1: br.submit<priority<1>>(normal_task); break;
+                        case 2: br.submit<priority<2>>(normal_task); break;
+                        default: br.submit<priority<3>>(normal_task); break;
+                    }
+                }
+                else if(urgent_first)
+                    br.submit<urgent>(normal_task);
+                else
+                    br.submit(normal_task);
+            }
+            auto t1 = bench_clock::now();
+            br.submit<urgent>([&] { urgent_pos = order.fetch_add(1, std::memory_order_relaxed); });
+            gate.store(true, std::memory_order_release);
+            br.wait_tasks();
+            auto t2 = bench_clock::now();
+            r.report({name, n, ns_per(t1 - t0, n),
+                      {{"drain_ns_per_task", ns_per(t2 - t1, n + 1)}, {"probe_urgent_position", static_cast<double>(urgent_pos)}}});
+        }
+    }
+
+    // 扩容延迟：先 del_worker 并等它退下，再 add_worker 并提交一个任务，计时到任务开始执行。
+    // 唯一的常驻线程被占住，任务只能由新加入的线程执行；standby_timeout 为 0 时每次都创建新线程，否则复用备用池中的线程
+    void bench_scale_up(bench_runner& r, std::size_t rounds) {
+        for(auto timeout : {std::chrono::milliseconds(0), std::chrono::milliseconds(10000)}) {
+            std::string name = std::string("scale_up/") + (timeout.count() ? "standby" : "new_thread");
+            if(!r.enabled(name))
+                continue;
+            branch_options opts;
+            opts.idle = idle_strategy::park;
+            opts.standby_timeout = timeout;
+            WorkBranch br(1, opts);
+            std::promise<void> gate;
+            std::shared_future<void> gate_fut = gate.get_future().share();
+            std::atomic<bool> started{false};
+            br.submit([&started, gate_fut] {
+                started.store(true, std::memory_order_release);
+                gate_fut.wait();
+            });
+            while(!started.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            br.add_worker();
+            std::vector<double> samples;
+            samples.reserve(rounds);
+            for(std::size_t i = 0; i < rounds; ++i) {
+                br.del_worker();
+                while(br.num_workers() > 1)
+                    std::this_thread::yield();
+                std::atomic<bool> ran{false};
+                auto t0 = bench_clock::now();
+                br.add_worker();
+                br.submit([&ran] { ran.store(true, std::memory_order_release); });
+                while(!ran.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                samples.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count());
+            }
+            gate.set_value();
+            br.wait_tasks();
+            double mean = 0;
+            for(double v : samples)
+                mean += v;
+            mean /= static_cast<double>(samples.size());
+            r.report({name, rounds, mean, percentiles(samples)});
+        }
+    }
+
+    // 稳定状态下每个任务的堆分配次数：预热几轮后统计 operator new 的调用次数
+    // resource:slab 为默认的 SlabResource，resource:new_delete 让分支直接使用通用分配器作为对照
+    void bench_allocations(bench_runner& r, std::size_t rounds, std::size_t per_round) {
+        for(bool pooled : {true, false}) {
+            std::string suffix = pooled ? "/resource:slab" : "/resource:new_delete";
+            branch_options opts;
+            if(!pooled)
+                opts.memory = std::pmr::new_delete_resource();
+            auto run = [&](const std::string& name, const branch_options& o, auto&& round) {
+                if(!r.enabled(name + suffix))
+                    return;
+                WorkBranch br(1, o);
+                for(int w = 0; w < 3; ++w)
+                    round(br);
+                std::uint64_t a0 = g_allocations.load();
+                auto t0 = bench_clock::now();
+                for(std::size_t i = 0; i < rounds; ++i)
+                    round(br);
+                auto t1 = bench_clock::now();
+                std::uint64_t a1 = g_allocations.load();
+                std::size_t n = rounds * per_round;
+                r.report({name + suffix, n, ns_per(t1 - t0, n),
+                          {{"allocs_per_task", static_cast<double>(a1 - a0) / static_cast<double>(n)}}});
+            };
+
+            std::atomic<std::size_t> done{0};
+            run("alloc/tp_submit_void", opts, [&](WorkBranch& br) {
+                for(std::size_t i = 0; i < per_round; ++i)
+                    br.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+                br.wait_tasks();
+            });
+            std::vector<std::future<std::size_t>> futs;
+            futs.reserve(per_round);
+            run("alloc/tp_submit_future", opts, [&](WorkBranch& br) {
+                futs.clear();
+                for(std::size_t i = 0; i < per_round; ++i)
+                    futs.push_back(br.submit([i] { return i; }));
+                for(auto& f : futs)
+                    f.get();
+            });
+            std::vector<tp::future<std::size_t>> tp_futs;
+            tp_futs.reserve(per_round);
+            run("alloc/tp_async", opts, [&](WorkBranch& br) {
+                tp_futs.clear();
+                for(std::size_t i = 0; i < per_round; ++i)
+                    tp_futs.push_back(async(br, [i] { return i; }));
+                for(auto& f : tp_futs)
+                    f.get();
+            });
+            branch_options stealing = opts;
+            stealing.work_stealing = true;
+            run("alloc/tp_stealing_spawn", stealing, [&](WorkBranch& br) {
+                br.submit([&br, &done, per_round] {
+                    for(std::size_t i = 1; i < per_round; ++i)
+                        br.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+                });
+                br.wait_tasks();
+            });
+        }
+    }
+
+    // 一个热点 strand：单个生产者连续投递，max_batch 为 1 时每条消息都要经过一次分支调度
+    void bench_strand(bench_runner& r, std::size_t n) {
+        for(std::size_t batch : {std::size_t(1), std::size_t(32)}) {
+            std::string name = "strand/tp_post/max_batch:" + std::to_string(batch);
+            if(!r.enabled(name))
+                continue;
+            WorkBranch br(1);
+            std::size_t count = 0;  // 只在 strand 上访问，不需要原子操作
+            auto t0 = bench_clock::now();
+            {
+                strand s(br, batch);
+                for(std::size_t i = 0; i < n; ++i)
+                    s.post([&count] { ++count; });
+            }
+            auto t1 = bench_clock::now();
+            r.report({name, n, ns_per(t1 - t0, n), {{"items_per_second", items_per_second(t1 - t0, n)}}});
+        }
+    }
+
+    // Workspace 分发：每次 submit 选择分支的开销，以及各分支执行任务数的均衡程度（最大值 / 平均值，1 为完全均衡）
+    // 任务耗时不均匀（0 ~ 7 个单位），直接提交到单个 WorkBranch 作为开销的参照
+    void bench_dispatch(bench_runner& r, int branches, std::size_t n) {
+        auto work = [](std::size_t units) {
+            volatile std::size_t x = 0;
+            for(std::size_t k = 0; k < units * 64; ++k)
+                x = x + k;
+        };
+        std::string suffix = "/branches:" + std::to_string(branches);
+        if(r.enabled("dispatch/tp_branch_direct")) {
+            WorkBranch br(1);
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < n; ++i)
+                br.submit([&work, i] { work(i % 8); });
+            auto t1 = bench_clock::now();
+            br.wait_tasks();
+            r.report({"dispatch/tp_branch_direct", n, ns_per(t1 - t0, n), {}});
+        }
+        for(bool affine : {false, true}) {
+            std::string name = std::string("dispatch/") + (affine ? "tp_workspace_affine" : "tp_workspace_p2c") + suffix;
+            if(!r.enabled(name))
+                continue;
+            Workspace ws;
+            std::vector<WorkBranch*> brs;
+            for(int b = 0; b < branches; ++b)
+                brs.push_back(&ws[ws.attach(new WorkBranch(1))]);
+            auto t0 = bench_clock::now();
+            for(std::size_t i = 0; i < n; ++i) {
+                if(affine)
+                    ws.submit_affine(i % 64, [&work, i] { work(i % 8); });
+                else
+                    ws.submit([&work, i] { work(i % 8); });
+            }
+            auto t1 = bench_clock::now();
+            ws.for_each([](WorkBranch& br) { br.wait_tasks(); });
+            double most = 0, sum = 0;
+            for(auto* br : brs) {
+                auto c = static_cast<double>(br->metrics().total.tasks_executed);
+                most = std::max(most, c);
+                sum += c;
+            }
+            r.report({name, n, ns_per(t1 - t0, n), {{"imbalance", most / (sum / static_cast<double>(branches))}}});
+        }
+    }
+
+    // 竞争扩展：producers 个线程同时提交，workers 个线程执行
+    void bench_contention(bench_runner& r, int producers, int workers, std::size_t n, bool stealing) {
+        std::string name = std::string("contention/") + (stealing ? "tp_stealing" : "tp_blocking") +
+                           "/producers:" + std::to_string(producers) + "/workers:" + std::to_string(workers);
+        if(!r.enabled(name))
+            return;
+        branch_options opts;
+        opts.work_stealing = stealing;
+        WorkBranch br(workers, opts);
+        std::atomic<std::size_t> done{0};
+        std::size_t per = n / static_cast<std::size_t>(producers);
+        std::size_t total = per * static_cast<std::size_t>(producers);
+        std::vector<std::thread> threads;
+        auto t0 = bench_clock::now();
+        for(int p = 0; p < producers; ++p)
+            threads.emplace_back([&] {
+                for(std::size_t i = 0; i < per; ++i)
+                    br.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+            });
+        for(auto& t : threads)
+            t.join();
+        wait_until(done, total);
+        auto t1 = bench_clock::now();
+        r.report({name, total, ns_per(t1 - t0, total), {{"items_per_second", items_per_second(t1 - t0, total)}}});
+    }
+
+    // parallel_reduce 与手写的 futures<T> 分块求和对比
+    void bench_parallel_reduce(bench_runner& r, int workers, std::size_t n, std::size_t grain) {
+        std::string suffix = "/workers:" + std::to_string(workers);
+        WorkBranch br(workers);
+        std::vector<double> data(n, 1.0);
+
+        if(r.enabled("reduce/tp_futures" + suffix)) {
+            auto t0 = bench_clock::now();
+            futures<double> futs;
+            for(std::size_t b = 0; b < n; b += grain) {
+                std::size_t e = std::min(n, b + grain);
+                futs.add_back(br.submit([&data, b, e] {
+                    double acc = 0;
+                    for(std::size_t i = b; i < e; ++i)
+                        acc += data[i];
+                    return acc;
+                }));
+            }
+            double sum = 0;
+            for(double part : futs.get())
+                sum += part;
+            auto t1 = bench_clock::now();
+            r.report({"reduce/tp_futures" + suffix, n, ns_per(t1 - t0, n), {{"sum", sum}}});
+        }
+        if(r.enabled("reduce/tp_parallel_reduce" + suffix)) {
+            auto t0 = bench_clock::now();
+            double sum = parallel_reduce(br, std::size_t(0), n, grain, 0.0,
+                                         [&data](std::size_t i) { return data[i]; },
+                                         [](double a, double b) { return a + b; });
+            auto t1 = bench_clock::now();
+            r.report({"reduce/tp_parallel_reduce" + suffix, n, ns_per(t1 - t0, n), {{"sum", sum}}});
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    bench_runner r(argc, argv);
+    int hw = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> worker_counts{1};
+    if(hw > 1)
+        worker_counts.push_back(hw);
+
+    for(int workers : worker_counts)
+        bench_enqueue(r, workers, 200000, 1000);
+    for(int workers : worker_counts)
+        bench_empty_task(r, workers, 200000);
+    for(int workers : worker_counts)
+        bench_round_trip(r, workers, 5000);
+    for(int workers : worker_counts)
+        bench_fan_out_in(r, workers, 500, 64);
+    bench_urgent_vs_normal(r, 100000);
+    bench_scale_up(r, 2000);
+    bench_dispatch(r, 4, 200000);
+    bench_allocations(r, 50, 2000);
+    bench_strand(r, 200000);
+    for(int producers = 1; producers <= std::max(hw, 4); producers *= 2)
+        for(int workers : worker_counts)
+            for(bool stealing : {false, true})
+                bench_contention(r, producers, workers, 200000, stealing);
+    for(int workers : worker_counts)
+        bench_parallel_reduce(r, workers, 1 << 24, 1 << 14);
+
+    r.finish();
+    return 0;
+}
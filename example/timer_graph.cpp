@@ -0,0 +1,143 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "Timer.h"
+#include "TaskGraph.h"
+
+using namespace tp;
+using namespace std::chrono_literals;
+
+static int failures = 0;
+
+static void expect(bool ok, const std::string& what) {
+    std::cout << (ok ? "[ok]   " : "[FAIL] ") << what << std::endl;
+    if(!ok)
+        ++failures;
+}
+
+// 等待条件成立，最多等 timeout
+template <typename Pred>
+static bool eventually(Pred pred, std::chrono::milliseconds timeout = 2000ms) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!pred()) {
+        if(std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+void example_timer() {
+    WorkBranch br(2);
+    Timer timer(br);
+
+    // 一次性定时任务：相对时间、steady_clock 和 system_clock 的绝对时间
+    std::atomic<int> once{0};
+    timer.submit_after(10ms, [&] { ++once; });
+    timer.submit_at(std::chrono::steady_clock::now() + 20ms, [&] { ++once; });
+    timer.submit_at<urgent>(std::chrono::system_clock::now() + 30ms, [&] { ++once; });
+    expect(eventually([&] { return once == 3; }), "submit_after / submit_at fire once each");
+
+    // 到期前取消的任务不会执行，句柄随之失效
+    std::atomic<bool> cancelled_ran{false};
+    timer_handle h = timer.submit_after(50ms, [&] { cancelled_ran = true; });
+    expect(h.pending(), "handle is pending before the deadline");
+    expect(h.cancel(), "cancel() before the deadline succeeds");
+    expect(!h.pending() && !h.cancel(), "a cancelled handle is no longer pending");
+    std::this_thread::sleep_for(80ms);
+    expect(!cancelled_ran, "a cancelled timer never runs");
+
+    // 周期任务一直执行到 cancel()
+    std::atomic<int> ticks{0};
+    timer_handle every = timer.submit_every(5ms, [&] { ++ticks; });
+    expect(eventually([&] { return ticks >= 3; }), "submit_every keeps firing");
+    expect(every.cancel(), "cancel() stops a periodic timer");
+    br.wait_tasks();
+    int stopped_at = ticks;
+    std::this_thread::sleep_for(30ms);
+    expect(ticks == stopped_at, "no ticks after cancel()");
+
+    expect(timer.num_pending() == 0, "nothing left in the timer heap");
+}
+
+// 分支已满时计时线程不会等待：定时任务超额入队，其他定时任务照常触发
+void example_timer_on_full_branch() {
+    branch_options opts;
+    opts.capacity = 1;
+    opts.overflow = overflow_policy::block;
+    WorkBranch br(1, opts);
+    Timer timer(br);
+
+    std::atomic<bool> release{false};
+    br.submit([&] { while(!release) std::this_thread::sleep_for(1ms); });
+    br.submit([] {});  // 占满唯一的空位
+    std::atomic<int> fired{0};
+    timer.submit_after(1ms, [&] { ++fired; });
+    std::this_thread::sleep_for(20ms);
+    timer.submit_after(1ms, [&] { ++fired; });  // 计时线程若卡在上一次提交，这个任务会一直留在堆中
+    std::this_thread::sleep_for(20ms);
+    expect(timer.num_pending() == 0, "timer thread is not blocked by a full branch");
+    release = true;
+    expect(eventually([&] { return fired == 2; }), "timers queued over capacity still run");
+}
+
+void example_task_graph() {
+    WorkBranch br(3);
+    TaskGraph graph;
+
+    // 菱形依赖：load -> left, right -> merge
+    std::atomic<int> step{0};
+    int seen_left = -1, seen_right = -1, seen_merge = -1;
+    auto& load = graph.emplace([&] { step = 1; });
+    auto& left = graph.emplace([&] { seen_left = step; });
+    auto& right = graph.emplace([&] { seen_right = step; });
+    auto& merge = graph.emplace([&] { seen_merge = seen_left + seen_right; });
+    load.precede(left, right);
+    merge.succeed(left, right);
+
+    for(int round = 0; round < 3; ++round) {  // 构建一次，反复运行
+        step = 0;
+        seen_left = seen_right = seen_merge = -1;
+        graph.run_and_wait(br);
+        expect(seen_left == 1 && seen_right == 1 && seen_merge == 2,
+               "task graph round " + std::to_string(round) + " respects dependencies");
+    }
+
+    // 节点抛出的第一个异常由 wait 重新抛出，之后的节点跳过
+    TaskGraph failing;
+    bool after_ran = false;
+    auto& bad = failing.emplace([] { throw std::runtime_error("node failed"); });
+    auto& after = failing.emplace([&] { after_ran = true; });
+    bad.precede(after);
+    bool caught = false;
+    try {
+        failing.run_and_wait(br);
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    expect(caught && !after_ran, "a failing node is rethrown by wait() and skips its successors");
+
+    TaskGraph cyclic;
+    auto& a = cyclic.emplace([] {});
+    auto& b = cyclic.emplace([] {});
+    a.precede(b);
+    b.precede(a);
+    bool rejected = false;
+    try {
+        cyclic.run(br);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    expect(rejected, "a cyclic graph is rejected");
+}
+
+int main() {
+    example_timer();
+    example_timer_on_full_branch();
+    example_task_graph();
+    std::cout << (failures == 0 ? "All checks passed." : "Some checks failed.") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// test/ 下各个 ctest 程序共用的断言：逐条打印结果，main 返回 finish() 作为退出码
+namespace check {
+    inline int failures = 0;
+
+    inline void expect(bool ok, const std::string& what) {
+        std::cout << (ok ? "[ok]   " : "[FAIL] ") << what << std::endl;
+        if(!ok)
+            ++failures;
+    }
+
+    // 等待条件成立，最多等 timeout
+    template <typename Pred>
+    bool eventually(Pred pred, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(!pred()) {
+            if(std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    inline int finish() {
+        std::cout << (failures == 0 ? "All checks passed." : "Some checks failed.") << std::endl;
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+#endif //TEST_CHECK_H
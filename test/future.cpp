@@ -0,0 +1,71 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "Future.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 大量短链 then：结果可能在挂上后续任务之前或之后就绪，两种顺序都要恰好调度一次后续任务
+void then_chains() {
+    WorkBranch br(3);
+    for(int round = 0; round < 20; ++round) {
+        std::vector<future<int>> fs;
+        for(int i = 0; i < 200; ++i)
+            fs.push_back(async(br, [i] { return i; })
+                             .then([](int x) { return x + 1; })
+                             .then([](int x) { return x * 2; }));
+        std::vector<int> all = when_all(std::move(fs)).get();
+        bool ok = all.size() == 200;
+        for(int i = 0; ok && i < 200; ++i)
+            ok = all[static_cast<std::size_t>(i)] == (i + 1) * 2;
+        if(!ok) {
+            expect(false, "when_all over then chains keeps the input order");
+            return;
+        }
+    }
+    expect(true, "when_all over then chains keeps the input order (20 rounds)");
+}
+
+// 任一输入失败时 when_all 以第一个异常结束，失败之后的后续任务不执行
+void when_all_failure() {
+    WorkBranch br(2);
+    std::atomic<int> continued{0};
+    std::vector<future<int>> fs;
+    for(int i = 0; i < 50; ++i)
+        fs.push_back(async(br, [i]() -> int {
+            if(i == 17)
+                throw std::runtime_error("input failed");
+            return i;
+        }).then([&](int x) { ++continued; return x; }));
+    bool caught = false;
+    try {
+        when_all(std::move(fs)).get();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    br.wait_tasks();
+    expect(caught, "when_all rethrows an input's exception");
+    expect(continued == 49, "the failed input skips its continuation");
+}
+
+// void 的 when_all 和已就绪 future 上的 then
+void void_and_ready() {
+    WorkBranch br(2);
+    std::atomic<int> ran{0};
+    std::vector<future<void>> fs;
+    for(int i = 0; i < 100; ++i)
+        fs.push_back(async(br, [&] { ++ran; }));
+    when_all(std::move(fs)).get();
+    expect(ran == 100, "when_all over void futures waits for every input");
+    int v = make_ready_future(20, &br).then([](int x) { return x + 1; }).get();
+    expect(v == 21, "then on a ready future runs the continuation");
+}
+
+int main() {
+    then_chains();
+    when_all_failure();
+    void_and_ready();
+    return check::finish();
+}
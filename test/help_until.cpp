@@ -0,0 +1,65 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Parallel.h"
+#include "TaskGraph.h"
+#include "TaskGroup.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+using namespace std::chrono_literals;
+
+// 等待者把队列里的任务都帮忙执行完后休眠，最后一个任务在别的线程上结束时必须叫醒它，否则 wait 永远不返回
+void group_wakes_parked_waiter() {
+    WorkBranch br(2);
+    for(int round = 0; round < 40; ++round) {
+        TaskGroup group(br);
+        std::atomic<int> ran{0};
+        for(int i = 0; i < 4; ++i)
+            group.submit([&, i] {
+                if(i == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(round % 4 * 1000));
+                ++ran;
+            });
+        group.wait();
+        if(ran != 4) {
+            expect(false, "TaskGroup::wait returns after every member ran");
+            return;
+        }
+    }
+    expect(true, "TaskGroup::wait wakes after a slow last member (40 rounds)");
+}
+
+void graph_wakes_parked_waiter() {
+    WorkBranch br(2);
+    TaskGraph graph;
+    std::atomic<int> ran{0};
+    auto& slow = graph.emplace([&] { std::this_thread::sleep_for(2ms); ++ran; });
+    auto& after = graph.emplace([&] { ++ran; });
+    slow.precede(after);
+    for(int round = 0; round < 20; ++round)
+        graph.run_and_wait(br);
+    expect(ran == 40, "TaskGraph::wait wakes after the last node finishes on a worker");
+}
+
+// 只有一个工作线程时，嵌套的 parallel_for 在工作线程里等待，依赖 help_until 执行自己的分块
+void nested_parallel_for_on_one_worker() {
+    WorkBranch br(1);
+    std::atomic<long> sum{0};
+    parallel_for(br, 0, 8, 1, [&](int) {
+        parallel_for(br, 0, 100, 1, [&](int j) {
+            if(j % 10 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            sum += j;
+        });
+    });
+    expect(sum == 8 * 4950, "nested parallel_for completes on a single worker");
+}
+
+int main() {
+    group_wakes_parked_waiter();
+    graph_wakes_parked_waiter();
+    nested_parallel_for_on_one_worker();
+    return check::finish();
+}
@@ -0,0 +1,90 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "RingQueue.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 容量很小的环形队列上多生产者多消费者并发收发，序号绕过槽位数组很多圈；
+// 每个值恰好收到一次，且同一个消费者看到的同一生产者的值保持递增（FIFO）
+void mpmc_wraparound() {
+    constexpr int producers = 3, consumers = 3, per_producer = 20000;
+    RingQueue<std::uint64_t> q(8);
+    std::vector<std::atomic<int>> seen(producers * per_producer);
+    std::atomic<int> received{0};
+    std::atomic<bool> ordered{true};
+
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p)
+        threads.emplace_back([&, p] {
+            for(int i = 0; i < per_producer; ++i) {
+                std::uint64_t v = static_cast<std::uint64_t>(p) << 32 | static_cast<std::uint32_t>(i);
+                if(p == 0)
+                    q.push(std::move(v));  // 阻塞版本
+                else if(p == 1) {
+                    while(q.try_push(std::move(v)) == push_status::full)
+                        std::this_thread::yield();
+                }
+                else {  // 批量版本，每批都可能跨过数组末尾
+                    std::uint64_t batch[3];
+                    int n = 0;
+                    for(; n < 3 && i + n < per_producer; ++n)
+                        batch[n] = static_cast<std::uint64_t>(p) << 32 | static_cast<std::uint32_t>(i + n);
+                    q.push_bulk(batch, static_cast<std::size_t>(n));
+                    i += n - 1;
+                }
+            }
+        });
+    for(int c = 0; c < consumers; ++c)
+        threads.emplace_back([&] {
+            std::int64_t last[producers] = {-1, -1, -1};
+            while(received.load(std::memory_order_relaxed) < producers * per_producer) {
+                std::uint64_t v;
+                if(!q.try_pop(v)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int p = static_cast<int>(v >> 32);
+                int i = static_cast<int>(v & 0xffffffffu);
+                if(i <= last[p])
+                    ordered = false;
+                last[p] = i;
+                seen[p * per_producer + i].fetch_add(1, std::memory_order_relaxed);
+                received.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    for(auto& t : threads)
+        t.join();
+
+    bool once = true;
+    for(auto& s : seen)
+        once = once && s.load() == 1;
+    expect(once, "every value is received exactly once");
+    expect(ordered, "values from one producer arrive in order");
+    std::uint64_t v;
+    expect(!q.try_pop(v), "the queue is empty afterwards");
+}
+
+// 满和空的边界：try_push 在满时返回 full，元素在队列析构时被销毁
+void full_and_destroy() {
+    auto token = std::make_shared<int>(0);
+    {
+        RingQueue<std::shared_ptr<int>> q(4);
+        int pushed = 0;
+        for(int i = 0; i < 6; ++i)
+            pushed += q.try_push(token) == push_status::ok;
+        expect(pushed == 4, "try_push reports full at capacity");
+        std::shared_ptr<int> out;
+        expect(q.try_pop(out) && q.try_push(token) == push_status::ok, "a pop frees exactly one slot");
+    }
+    expect(token.use_count() == 1, "queued elements are destroyed with the queue");
+}
+
+int main() {
+    mpmc_wraparound();
+    full_and_destroy();
+    return check::finish();
+}
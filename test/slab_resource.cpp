@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RingQueue.h"
+#include "SlabResource.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+struct block {
+    void* p;
+    std::size_t bytes;
+    std::uint32_t tag;
+};
+
+// 生产者线程分配并写入各自的标记，消费者线程检查标记后释放：
+// 跨线程释放的块经共享仓库回到分配者，重新分配时不能与仍在使用的块重叠
+void cross_thread_free() {
+    constexpr int producers = 2, per_producer = 40000;
+    SlabResource slab;
+    RingQueue<block> handoff(256);
+    std::atomic<int> freed{0};
+    std::atomic<int> corrupted{0};
+
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p)
+        threads.emplace_back([&, p] {
+            std::vector<block> own;  // 一部分留在本线程，和跨线程释放的块交错使用
+            for(int i = 0; i < per_producer; ++i) {
+                std::size_t bytes = 16 + static_cast<std::size_t>(i % 8) * 24;
+                std::uint32_t tag = static_cast<std::uint32_t>(p * per_producer + i);
+                void* mem = slab.allocate(bytes, alignof(std::max_align_t));
+                std::memset(mem, static_cast<int>(tag & 0xff), bytes);
+                block b{mem, bytes, tag};
+                if(i % 4 == 0)
+                    own.push_back(b);
+                else
+                    handoff.push(std::move(b));
+                if(own.size() > 64) {
+                    for(auto& o : own) {
+                        if(static_cast<unsigned char*>(o.p)[o.bytes - 1] != (o.tag & 0xff))
+                            ++corrupted;
+                        slab.deallocate(o.p, o.bytes, alignof(std::max_align_t));
+                        ++freed;
+                    }
+                    own.clear();
+                }
+            }
+            for(auto& o : own) {
+                slab.deallocate(o.p, o.bytes, alignof(std::max_align_t));
+                ++freed;
+            }
+        });
+    threads.emplace_back([&] {
+        block b;
+        while(freed.load(std::memory_order_relaxed) < producers * per_producer) {
+            if(!handoff.try_pop(b)) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto* bytes = static_cast<unsigned char*>(b.p);
+            for(std::size_t k = 0; k < b.bytes; ++k)
+                if(bytes[k] != (b.tag & 0xff)) {
+                    ++corrupted;
+                    break;
+                }
+            slab.deallocate(b.p, b.bytes, alignof(std::max_align_t));
+            ++freed;
+        }
+    });
+    for(auto& t : threads)
+        t.join();
+
+    expect(corrupted == 0, "no block is handed out twice while still in use");
+    expect(freed == producers * per_producer, "every block is freed");
+    std::size_t reserved = slab.reserved_bytes();
+    expect(reserved < std::size_t(producers) * per_producer * 64, "freed blocks are reused instead of growing the pool");
+}
+
+// 线程退出后，它本地缓存中的块回到仓库，之后的线程可以继续使用
+void thread_exit_returns_cache() {
+    SlabResource slab;
+    for(int round = 0; round < 20; ++round) {
+        std::thread([&] {
+            std::vector<void*> v;
+            for(int i = 0; i < 200; ++i)
+                v.push_back(slab.allocate(48));
+            for(void* p : v)
+                slab.deallocate(p, 48);
+        }).join();
+    }
+    std::size_t after_rounds = slab.reserved_bytes();
+    std::thread([&] {
+        std::vector<void*> v;
+        for(int i = 0; i < 200; ++i)
+            v.push_back(slab.allocate(48));
+        for(void* p : v)
+            slab.deallocate(p, 48);
+    }).join();
+    expect(slab.reserved_bytes() == after_rounds, "a new thread reuses the blocks left by exited threads");
+}
+
+int main() {
+    cross_thread_free();
+    thread_exit_returns_cache();
+    return check::finish();
+}
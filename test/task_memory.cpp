@@ -0,0 +1,69 @@
+#include <array>
+#include <atomic>
+#include <memory_resource>
+#include "WorkBranch.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 统计分配次数的资源，实际分配交给 new_delete_resource
+class counting_resource : public std::pmr::memory_resource {
+public:
+    std::atomic<long> live{0};
+    std::atomic<long> total{0};
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        ++live;
+        ++total;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+static_assert(sizeof(std::array<long, 32>) > Task::inline_size, "the payload must not fit inline");
+
+// 放不进 Task 内部的任务从 branch_options::memory 分配，并归还给它
+void oversized_tasks_use_branch_memory() {
+    counting_resource mr;
+    {
+        branch_options opts;
+        opts.memory = &mr;
+        WorkBranch br(2, opts);
+        long before = mr.total;
+        std::atomic<long> sum{0};
+        for(int i = 0; i < 100; ++i) {
+            std::array<long, 32> big{};
+            big[0] = i;
+            br.submit([&sum, big] { sum += big[0]; });
+        }
+        br.wait_tasks();
+        expect(sum == 99 * 100 / 2, "oversized tasks run");
+        expect(mr.total - before >= 100, "oversized task payloads come from branch_options::memory");
+    }
+    expect(mr.live == 0, "every payload is returned to the resource that allocated it");
+}
+
+// 大任务在分支之间移动（例如经过另一个容器）后，仍然释放给分配它的资源
+void moved_task_frees_to_its_resource() {
+    counting_resource mr;
+    {
+        std::array<long, 32> big{};
+        Task a(std::allocator_arg, &mr, [big] { (void)big; });
+        Task b(std::move(a));
+        expect(mr.live == 1, "an oversized Task allocates once from the given resource");
+        b();
+    }
+    expect(mr.live == 0, "the moved-to Task frees into the original resource");
+}
+
+int main() {
+    oversized_tasks_use_branch_memory();
+    moved_task_frees_to_its_resource();
+    return check::finish();
+}
@@ -0,0 +1,81 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "WorkStealingDeque.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 拥有者和窃取者同时争抢仅剩的一个元素：队列大多数时候只有 0 或 1 个元素，
+// pop 和 steal 不断在最后一个元素上竞争。每个元素必须恰好被取走一次
+void last_element_race() {
+    constexpr int items = 100000, thieves = 2;
+    WorkStealingDeque<int> dq(2);
+    std::vector<std::atomic<int>> taken(items);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < thieves; ++t)
+        threads.emplace_back([&] {
+            int v;
+            while(!done.load(std::memory_order_acquire) || !dq.empty()) {
+                if(dq.steal(v))
+                    taken[v].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    int v;
+    for(int i = 0; i < items; ++i) {
+        dq.push(i);
+        if(i % 3 != 0 && dq.pop(v))
+            taken[v].fetch_add(1, std::memory_order_relaxed);
+    }
+    while(dq.pop(v))
+        taken[v].fetch_add(1, std::memory_order_relaxed);
+    done.store(true, std::memory_order_release);
+    for(auto& t : threads)
+        t.join();
+
+    int lost = 0, duplicated = 0;
+    for(auto& n : taken) {
+        lost += n.load() == 0;
+        duplicated += n.load() > 1;
+    }
+    expect(lost == 0 && duplicated == 0, "pop and steal never lose or duplicate the last element");
+}
+
+// 窃取者读取时拥有者扩容：旧数组保留到队列析构，窃取到的值仍然有效
+void grow_while_stealing() {
+    constexpr int items = 50000;
+    WorkStealingDeque<int> dq(4);
+    std::vector<std::atomic<int>> taken(items);
+    std::atomic<bool> done{false};
+    std::thread thief([&] {
+        int v;
+        while(!done.load(std::memory_order_acquire) || !dq.empty())
+            if(dq.steal(v))
+                taken[v].fetch_add(1, std::memory_order_relaxed);
+    });
+    int v;
+    for(int i = 0; i < items; ++i) {
+        dq.push(i);
+        if(i % 1000 == 999)  // 成批压入、成批弹出，反复触发扩容
+            for(int k = 0; k < 500 && dq.pop(v); ++k)
+                taken[v].fetch_add(1, std::memory_order_relaxed);
+    }
+    while(dq.pop(v))
+        taken[v].fetch_add(1, std::memory_order_relaxed);
+    done.store(true, std::memory_order_release);
+    thief.join();
+
+    bool once = true;
+    for(auto& n : taken)
+        once = once && n.load() == 1;
+    expect(once, "every element is taken exactly once while the deque grows");
+}
+
+int main() {
+    last_element_race();
+    grow_while_stealing();
+    return check::finish();
+}
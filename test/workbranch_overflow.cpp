@@ -0,0 +1,89 @@
+#include <atomic>
+#include <stdexcept>
+#include "Parallel.h"
+#include "WorkBranch.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 唯一的工作线程被占住，ring 后端只能放下 ring_capacity 个任务
+struct blocked_branch {
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    WorkBranch br;
+
+    explicit blocked_branch(const branch_options& opts) : br(1, opts) {
+        br.submit([this] { started = true; while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+        check::eventually([this] { return started.load(); });
+    }
+    ~blocked_branch() {
+        release = true;
+        br.wait_tasks();
+    }
+};
+
+void try_submit_on_full_ring(std::size_t capacity) {
+    branch_options opts;
+    opts.backend = queue_backend::ring;
+    opts.ring_capacity = 2;
+    opts.capacity = capacity;
+    blocked_branch b(opts);
+    std::atomic<int> ran{0};
+    int accepted = 0, rejected = 0;
+    for(int i = 0; i < 8; ++i) {  // ring 满时不等待，直接返回 rejected
+        submit_status s = b.br.try_submit([&] { ++ran; });
+        accepted += s == submit_status::accepted;
+        rejected += s == submit_status::rejected;
+    }
+    std::string name = "capacity " + std::to_string(capacity);
+    expect(accepted == 2 && rejected == 6, name + ": try_submit rejects once the ring is full");
+    expect(b.br.num_in_flight() == 3 && b.br.metrics().rejected == 6, name + ": a rejected try_submit is not counted in flight");
+    b.release = true;
+    b.br.wait_tasks();
+    expect(ran == 2, name + ": the accepted tasks run");
+    expect(b.br.try_submit([&] { ++ran; }) == submit_status::accepted, name + ": try_submit accepts again once the ring drains");
+}
+
+void reject_policy_on_full_ring() {
+    branch_options opts;
+    opts.backend = queue_backend::ring;
+    opts.ring_capacity = 2;
+    opts.capacity = 100;  // 大于 ring 的容量
+    opts.overflow = overflow_policy::reject;
+    blocked_branch b(opts);
+    int thrown = 0;
+    for(int i = 0; i < 4; ++i) {
+        try {
+            b.br.submit([] {});
+        } catch (const std::runtime_error&) {
+            ++thrown;
+        }
+    }
+    expect(thrown == 2, "reject: submit throws instead of waiting on a full ring");
+    expect(b.br.num_tasks() == 2, "reject: only the tasks that fit are queued");
+}
+
+// 调度器内部的任务在各种策略下都能经过很小的 ring 完成：放不进去时溢出到互斥队列，drop_oldest 下不进入 ring
+void internal_tasks_on_small_ring() {
+    for(overflow_policy policy : {overflow_policy::block, overflow_policy::reject,
+                                  overflow_policy::caller_runs, overflow_policy::drop_oldest}) {
+        branch_options opts;
+        opts.backend = queue_backend::ring;
+        opts.ring_capacity = 2;
+        opts.capacity = 4;
+        opts.overflow = policy;
+        WorkBranch br(2, opts);
+        std::atomic<long> sum{0};
+        parallel_for(br, 0, 1000, 1, [&](int i) { sum += i; });
+        expect(sum == 999 * 1000 / 2, "policy " + std::to_string(static_cast<int>(policy)) + ": parallel_for completes on a small ring");
+    }
+}
+
+int main() {
+    try_submit_on_full_ring(0);
+    try_submit_on_full_ring(100);
+    reject_policy_on_full_ring();
+    internal_tasks_on_small_ring();
+    return check::finish();
+}
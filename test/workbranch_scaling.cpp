@@ -0,0 +1,69 @@
+#include <atomic>
+#include <stdexcept>
+#include "WorkBranch.h"
+#include "test/check.h"
+
+using namespace tp;
+using check::expect;
+
+// 连续缩容到 0 再扩容一次，分支必须留下一个能执行任务的线程
+void scale_down_then_up(const branch_options& opts, const std::string& name) {
+    WorkBranch br(1, opts);
+    br.del_worker();
+    bool threw = false;
+    try {
+        br.del_worker();  // 唯一的线程已经在等着退出
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    expect(threw, name + ": del_worker beyond the live workers throws");
+    br.add_worker();
+    std::atomic<int> ran{0};
+    for(int i = 0; i < 100; ++i)
+        br.submit([&] { ++ran; });
+    br.wait_tasks();
+    expect(ran == 100 && br.num_workers() == 1, name + ": del, del, add still leaves a working thread");
+}
+
+// 缩容生效之后再扩容：decline 已被线程消费，add_worker 应当新建（或复用）线程
+void scale_after_exit(const branch_options& opts, const std::string& name) {
+    WorkBranch br(2, opts);
+    br.del_worker();
+    br.del_worker();
+    expect(check::eventually([&] { return br.num_workers() == 0; }), name + ": both workers leave");
+    br.add_worker();
+    std::atomic<int> ran{0};
+    for(int i = 0; i < 100; ++i)
+        br.submit([&] { ++ran; });
+    br.wait_tasks();
+    expect(ran == 100, name + ": add_worker after the workers left starts a new one");
+}
+
+// 线程还在执行任务、没来得及退出时，num_workers() 已经不再计入它
+void pending_decline_not_counted() {
+    WorkBranch br(2);
+    std::atomic<bool> release{false};
+    std::atomic<int> started{0};
+    for(int i = 0; i < 2; ++i)
+        br.submit([&] { ++started; while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+    check::eventually([&] { return started == 2; });
+    br.del_worker();
+    expect(br.num_workers() == 1, "num_workers() excludes a pending del_worker");
+    br.add_worker();
+    expect(br.num_workers() == 2, "add_worker cancels the pending del_worker");
+    release = true;
+    br.wait_tasks();
+}
+
+int main() {
+    branch_options plain;
+    plain.standby_timeout = std::chrono::milliseconds(0);  // 缩容的线程直接退出
+    branch_options standby;
+    standby.standby_timeout = std::chrono::milliseconds(200);
+    scale_down_then_up(plain, "plain");
+    scale_down_then_up(standby, "standby");
+    scale_after_exit(plain, "plain");
+    scale_after_exit(standby, "standby");
+    pending_decline_not_counted();
+    return check::finish();
+}